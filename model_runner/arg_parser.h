@@ -0,0 +1,108 @@
+#pragma once
+
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+
+class ArgParser
+{
+public:
+    template<class T>
+    void AddArg(T* value, const std::string& name, std::string help, bool optional = false)
+    {
+        std::unique_ptr<ArgImpl<T>> arg(new ArgImpl<T>);
+        arg->name = "-" + name;
+        arg->help = std::move(help);
+        arg->value = value;
+        arg->has_value = optional;
+        args_.insert(std::make_pair("-" + name, std::move(arg)));
+    }
+
+    void Parse(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            if (argv[i] == std::string("-help"))
+            {
+                throw std::runtime_error(HelpString());
+            }
+
+            if (argv[i][0] == '-')
+            {
+                if (i % 2 != 1)
+                {
+                    throw std::runtime_error("Missing option value: " + std::string(argv[i - 1]));
+                }
+            }
+            else
+            {
+                if (i % 2 != 0)
+                {
+                    throw std::runtime_error("Missing option name: " + std::string(argv[i])
+                                             + "\n" + HelpString());
+                }
+                auto arg = args_.find(argv[i - 1]);
+                if (arg == args_.end())
+                {
+                    throw std::runtime_error("Unknown option: " + std::string(argv[i - 1])
+                                             + "\n" + HelpString());
+                }
+                arg->second->Parse(argv[i]);
+            }
+        }
+
+        for (auto& arg : args_)
+        {
+            if (!arg.second->has_value)
+            {
+                throw std::runtime_error("Missing option: " + arg.second->name
+                                         + "\n" + HelpString());
+            }
+        }
+    }
+
+private:
+    struct Arg
+    {
+        virtual void Parse(const std::string& value) = 0;
+
+        std::string name;
+        std::string help;
+        bool has_value = false;
+    };
+
+    template<class T>
+    struct ArgImpl : Arg
+    {
+        void Parse(const std::string& string) override
+        {
+            std::istringstream stream(string);
+            stream >> *value;
+            if (stream.fail() && ! stream.eof())
+            {
+                throw std::runtime_error("Bad parameter " + name + ": " + string);
+            }
+            has_value = true;
+        }
+
+        T* value = nullptr;
+    };
+
+    std::string HelpString() const
+    {
+        std::ostringstream stream;
+        stream << "Available options:\n";
+        for (auto& arg : args_)
+        {
+            stream << std::setw(5) << std::setfill(' ') << "" << arg.second->name
+                << ": " << arg.second->help << "\n";
+        }
+        return stream.str();
+    }
+
+    std::map<std::string, std::unique_ptr<Arg>> args_;
+};
@@ -0,0 +1,340 @@
+#include "arg_parser.h"
+#include "json.h"
+#include "model_runner.h"
+#include "tool_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+typedef std::chrono::steady_clock Clock;
+
+double GetMilliseconds(Clock::time_point start, Clock::time_point end = Clock::now())
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Splits a comma-delimited list
+std::vector<std::string> SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');)
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::vector<std::pair<size_t, size_t>> ParseResolutions(const std::string& list)
+{
+    std::vector<std::pair<size_t, size_t>> resolutions;
+    for (auto& item : SplitList(list))
+    {
+        size_t width = 0;
+        size_t height = 0;
+        char separator = 0;
+        std::istringstream stream(item);
+        if (!(stream >> width >> separator >> height) || separator != 'x' || width == 0 || height == 0)
+        {
+            throw std::runtime_error("Bad resolution: " + item + ", expected WIDTHxHEIGHT");
+        }
+        resolutions.emplace_back(width, height);
+    }
+    return resolutions;
+}
+
+std::vector<size_t> ParseThreadCounts(const std::string& list)
+{
+    std::vector<size_t> thread_counts;
+    for (auto& item : SplitList(list))
+    {
+        thread_counts.push_back(std::stoul(item));
+    }
+    return thread_counts;
+}
+
+// Nearest-rank percentile of sorted values
+double GetPercentile(const std::vector<double>& sorted, double percentile)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(percentile / 100 * sorted.size() + 0.5);
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+struct BenchParams
+{
+    std::string model_path;
+    std::string input_node;
+    std::string output_node;
+    size_t iterations;
+    size_t warmup;
+    size_t streams;
+};
+
+struct BenchResult
+{
+    size_t threads;
+    size_t width;
+    size_t height;
+    double load_ms;
+    double set_input_ms;
+    double first_inference_ms;
+    std::vector<double> latencies_ms; // Sorted
+    double throughput; // Inferences per second
+};
+
+// Loads the model in a new context, so no loaded data is shared between
+// configurations, and measures the inference of `streams` concurrent callers
+BenchResult RunBench(const BenchParams& bench, size_t threads, size_t width, size_t height)
+{
+    BenchResult result = {};
+    result.threads = threads;
+    result.width = width;
+    result.height = height;
+
+    ml_context context = mlCreateContext();
+    if (context == ML_INVALID_HANDLE)
+    {
+        throw std::runtime_error("Error creating context");
+    }
+
+    auto context_releaser = MakeReleaser(context, &mlReleaseContext);
+
+    ml_model_params params = {};
+    params.model_path = bench.model_path.c_str();
+    params.input_node = bench.input_node.empty() ? nullptr : bench.input_node.c_str();
+    params.output_node = bench.output_node.empty() ? nullptr : bench.output_node.c_str();
+    params.intra_op_threads = threads;
+    params.use_per_session_threads = 1;
+
+    auto start = Clock::now();
+    ml_model model = mlCreateModel(context, &params);
+    result.load_ms = GetMilliseconds(start);
+    CheckContextStatus(context, model != ML_INVALID_HANDLE);
+
+    auto model_releaser = MakeReleaser(model, &mlReleaseModel);
+
+    ml_image_info input_info;
+    ml_image_info output_info;
+    CheckModelStatus(model, mlGetModelInfo(model, &input_info, nullptr) == ML_OK);
+
+    input_info.width = width;
+    input_info.height = height;
+
+    start = Clock::now();
+    CheckModelStatus(model, mlSetModelInputInfo(model, &input_info) == ML_OK);
+    result.set_input_ms = GetMilliseconds(start);
+
+    CheckModelStatus(model, mlGetModelInfo(model, &input_info, &output_info) == ML_OK);
+
+    std::vector<ml_image> images;
+    auto release_images = [&images](void*)
+    {
+        std::for_each(images.begin(), images.end(), &mlReleaseImage);
+    };
+    std::unique_ptr<void, decltype(release_images)> images_releaser(&images, release_images);
+
+    for (size_t i = 0; i < bench.streams; i++)
+    {
+        for (auto info : { &input_info, &output_info })
+        {
+            ml_image image = mlCreateImage(context, info);
+            CheckContextStatus(context, image != ML_INVALID_HANDLE);
+            images.push_back(image);
+
+            size_t size;
+            void* data = mlMapImage(image, &size);
+            std::memset(data, 0, size);
+            mlUnmapImage(image, data);
+        }
+    }
+
+    start = Clock::now();
+    CheckModelStatus(model, mlInfer(model, images[0], images[1]) == ML_OK);
+    result.first_inference_ms = GetMilliseconds(start);
+
+    for (size_t i = 0; i < bench.warmup; i++)
+    {
+        CheckModelStatus(model, mlInfer(model, images[0], images[1]) == ML_OK);
+    }
+
+    // Each stream runs the iterations with its own images
+    std::vector<std::vector<double>> stream_latencies(bench.streams);
+    std::vector<std::string> errors(bench.streams);
+
+    auto run_stream = [&](size_t stream)
+    {
+        for (size_t i = 0; i < bench.iterations && errors[stream].empty(); i++)
+        {
+            auto inference_start = Clock::now();
+            if (mlInfer(model, images[2 * stream], images[2 * stream + 1]) != ML_OK)
+            {
+                std::vector<char> buffer(1024);
+                errors[stream] = mlGetModelError(model, buffer.data(), buffer.size());
+            }
+            stream_latencies[stream].push_back(GetMilliseconds(inference_start));
+        }
+    };
+
+    start = Clock::now();
+
+    std::vector<std::thread> stream_threads;
+    for (size_t stream = 1; stream < bench.streams; stream++)
+    {
+        stream_threads.emplace_back(run_stream, stream);
+    }
+    run_stream(0);
+    std::for_each(stream_threads.begin(), stream_threads.end(), [](std::thread& t) { t.join(); });
+
+    double total_ms = GetMilliseconds(start);
+
+    for (auto& error : errors)
+    {
+        if (!error.empty())
+        {
+            throw std::runtime_error(error);
+        }
+    }
+
+    for (auto& latencies : stream_latencies)
+    {
+        result.latencies_ms.insert(result.latencies_ms.end(), latencies.begin(), latencies.end());
+    }
+    std::sort(result.latencies_ms.begin(), result.latencies_ms.end());
+
+    result.throughput = total_ms > 0 ? result.latencies_ms.size() * 1000. / total_ms : 0;
+    return result;
+}
+
+void WriteJson(std::ostream& stream, const BenchParams& bench, const std::vector<BenchResult>& results)
+{
+    stream << std::fixed << std::setprecision(3)
+           << "{\n"
+           << "  \"model\": " << JsonString(bench.model_path) << ",\n"
+           << "  \"iterations\": " << bench.iterations << ",\n"
+           << "  \"warmup\": " << bench.warmup << ",\n"
+           << "  \"streams\": " << bench.streams << ",\n"
+           << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+           << "  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto& result = results[i];
+        auto& latencies = result.latencies_ms;
+        double mean = latencies.empty() ? 0 :
+            std::accumulate(latencies.begin(), latencies.end(), 0.) / latencies.size();
+
+        stream << (i == 0 ? "\n" : ",\n")
+               << "    {\n"
+               << "      \"threads\": " << result.threads << ",\n"
+               << "      \"width\": " << result.width << ",\n"
+               << "      \"height\": " << result.height << ",\n"
+               << "      \"load_ms\": " << result.load_ms << ",\n"
+               << "      \"set_input_ms\": " << result.set_input_ms << ",\n"
+               << "      \"first_inference_ms\": " << result.first_inference_ms << ",\n"
+               << "      \"latency_ms\": {\n"
+               << "        \"min\": " << (latencies.empty() ? 0 : latencies.front()) << ",\n"
+               << "        \"mean\": " << mean << ",\n"
+               << "        \"p50\": " << GetPercentile(latencies, 50) << ",\n"
+               << "        \"p95\": " << GetPercentile(latencies, 95) << ",\n"
+               << "        \"p99\": " << GetPercentile(latencies, 99) << ",\n"
+               << "        \"max\": " << (latencies.empty() ? 0 : latencies.back()) << "\n"
+               << "      },\n"
+               << "      \"throughput_fps\": " << result.throughput << ",\n"
+               << "      \"megapixels_per_second\": "
+               << result.throughput * result.width * result.height / 1e6 << "\n"
+               << "    }";
+    }
+
+    stream << "\n  ]\n}\n";
+}
+
+
+int main(int argc, char* argv[])
+try
+{
+    ArgParser parser;
+    BenchParams bench;
+
+    parser.AddArg(&bench.model_path, "m", "Path to TensorFlow model (protobuf format)");
+    parser.AddArg(&bench.input_node, "in", "Input node name, autodetect if omitted", true);
+    parser.AddArg(&bench.output_node, "on", "Output node name, autodetect if omitted", true);
+
+    std::string resolutions = "512x512";
+    parser.AddArg(&resolutions, "r", "Comma-delimited input resolutions, e.g. 1920x1080,3840x2160,"
+                  " 512x512 if omitted", true);
+
+    std::string thread_counts = "0";
+    parser.AddArg(&thread_counts, "t", "Comma-delimited intra-op thread counts, e.g. 4,8,16,"
+                  " 0 for all cores, 0 if omitted", true);
+
+    bench.iterations = 50;
+    parser.AddArg(&bench.iterations, "n", "Measured inferences per stream, 50 if omitted", true);
+
+    bench.warmup = 3;
+    parser.AddArg(&bench.warmup, "warmup",
+                  "Unmeasured inferences after the first one, 3 if omitted", true);
+
+    bench.streams = 1;
+    parser.AddArg(&bench.streams, "s", "Concurrent inference streams, 1 if omitted", true);
+
+    std::string output_file;
+    parser.AddArg(&output_file, "o", "File for JSON results, write to stdout if omitted", true);
+
+    parser.Parse(argc, argv);
+
+    if (bench.iterations == 0 || bench.streams == 0)
+    {
+        throw std::runtime_error("Iteration and stream counts must not be 0");
+    }
+
+    std::vector<BenchResult> results;
+
+    for (size_t threads : ParseThreadCounts(thread_counts))
+    {
+        for (auto& resolution : ParseResolutions(resolutions))
+        {
+            std::cerr << "Threads: " << threads << ", resolution: "
+                      << resolution.first << "x" << resolution.second << "\n";
+
+            results.push_back(RunBench(bench, threads, resolution.first, resolution.second));
+        }
+    }
+
+    if (output_file.empty())
+    {
+        WriteJson(std::cout, bench, results);
+    }
+    else
+    {
+        std::ofstream stream(output_file);
+        if (stream.fail())
+        {
+            throw std::runtime_error("Error writing " + output_file);
+        }
+        WriteJson(stream, bench, results);
+    }
+}
+catch (std::exception& e)
+{
+    std::cerr << e.what() << std::endl;
+    return -1;
+}
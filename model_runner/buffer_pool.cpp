@@ -0,0 +1,334 @@
+#include "buffer_pool.h"
+
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/platform/mem.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace ML {
+
+class BufferPool::Buffer : public tensorflow::TensorBuffer
+{
+public:
+    Buffer(void* data, size_t size, std::shared_ptr<BufferPool> pool)
+        : tensorflow::TensorBuffer(data)
+        , m_size(size)
+        , m_pool(std::move(pool))
+    {
+    }
+
+    ~Buffer() override
+    {
+        m_pool->Release(data(), m_size);
+    }
+
+    size_t size() const override
+    {
+        return m_size;
+    }
+
+    tensorflow::TensorBuffer* root_buffer() override
+    {
+        return this;
+    }
+
+    void FillAllocationDescription(tensorflow::AllocationDescription* proto) const override
+    {
+        proto->set_requested_bytes(m_size);
+        proto->set_allocator_name("ml_buffer_pool");
+    }
+
+private:
+    size_t m_size;
+    std::shared_ptr<BufferPool> m_pool;
+};
+
+BufferPool::BufferPool(const ml_context_params& params)
+    : m_max_pooled_size(params.image_pool_size)
+    , m_huge_pages(params.huge_pages)
+    , m_numa_node_mask(params.numa_node_mask)
+{
+    if (m_huge_pages != ML_HUGE_PAGES_NONE &&
+        m_huge_pages != ML_HUGE_PAGES_TRANSPARENT &&
+        m_huge_pages != ML_HUGE_PAGES_EXPLICIT)
+    {
+        throw std::runtime_error("Bad huge_pages context parameter value");
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    Trim();
+}
+
+tensorflow::TensorBuffer* BufferPool::Allocate(size_t size)
+{
+    size_t size_class = GetSizeClass(size);
+    void* data = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_stats.allocation_count++;
+        m_stats.allocated_bytes += size_class;
+        m_max_buffer_size = std::max(m_max_buffer_size, size_class);
+
+        // The most recently released buffer is the most likely to be cached
+        auto free_buffers = m_free_buffers.find(size_class);
+        if (free_buffers != m_free_buffers.end())
+        {
+            auto free_buffer = free_buffers->second.back();
+            data = free_buffer->data;
+
+            free_buffers->second.pop_back();
+            if (free_buffers->second.empty())
+            {
+                m_free_buffers.erase(free_buffers);
+            }
+            m_free_list.erase(free_buffer);
+
+            m_stats.hit_count++;
+            m_stats.pooled_bytes -= size_class;
+        }
+    }
+
+    if (data == nullptr)
+    {
+        try
+        {
+            data = AllocateMemory(size_class);
+            if (data == nullptr)
+            {
+                throw std::runtime_error("Error allocating " + std::to_string(size_class) + " bytes");
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.allocated_bytes -= size_class;
+            throw;
+        }
+    }
+
+    return new Buffer(data, size_class, shared_from_this());
+}
+
+tensorflow::Tensor BufferPool::AllocateTensor(tensorflow::DataType dtype,
+                                              const tensorflow::TensorShape& shape)
+{
+    auto buffer = Allocate(shape.num_elements() * tensorflow::DataTypeSize(dtype));
+    tensorflow::Tensor tensor(dtype, shape, buffer);
+    buffer->Unref();
+    return tensor;
+}
+
+void BufferPool::Trim()
+{
+    FreeList free_list;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        free_list.swap(m_free_list);
+        m_free_buffers.clear();
+        m_stats.pooled_bytes = 0;
+    }
+
+    for (auto& free_buffer : free_list)
+    {
+        FreeMemory(free_buffer.data, free_buffer.size);
+    }
+}
+
+void BufferPool::GetStats(ml_image_pool_stats* stats) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    *stats = m_stats;
+}
+
+size_t BufferPool::GetSizeClass(size_t size)
+{
+    // Four classes per power of two, so less than a fifth of a buffer
+    // is unused, while frames of slightly different sizes share a class
+    size_t power = kAlignment;
+    while (power <= size / 2)
+    {
+        power *= 2;
+    }
+
+    size_t step = std::max(power / 4, kAlignment);
+    return (std::max<size_t>(size, 1) + step - 1) / step * step;
+}
+
+void BufferPool::Release(void* data, size_t size)
+{
+    FreeList evicted;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_stats.allocated_bytes -= size;
+
+        size_t max_pooled_size = GetMaxPooledSize();
+        if (size > max_pooled_size)
+        {
+            evicted.push_back({ data, size });
+        }
+        else
+        {
+            m_free_list.push_front({ data, size });
+            m_free_buffers[size].push_back(m_free_list.begin());
+            m_stats.pooled_bytes += size;
+
+            // The least recently released buffers are evicted first,
+            // they are the first ones of their size classes
+            while (m_stats.pooled_bytes > max_pooled_size)
+            {
+                auto free_buffer = std::prev(m_free_list.end());
+                auto free_buffers = m_free_buffers.find(free_buffer->size);
+
+                free_buffers->second.pop_front();
+                if (free_buffers->second.empty())
+                {
+                    m_free_buffers.erase(free_buffers);
+                }
+
+                m_stats.pooled_bytes -= free_buffer->size;
+                evicted.splice(evicted.end(), m_free_list, free_buffer);
+            }
+        }
+    }
+
+    for (auto& free_buffer : evicted)
+    {
+        FreeMemory(free_buffer.data, free_buffer.size);
+    }
+}
+
+size_t BufferPool::GetMaxPooledSize() const
+{
+    if (m_max_pooled_size != 0)
+    {
+        return m_max_pooled_size;
+    }
+
+    return std::max(kDefaultPoolSizeFactor * m_max_buffer_size, kMinDefaultPoolSize);
+}
+
+bool BufferPool::IsPageMapped(size_t size) const
+{
+#ifdef __linux__
+    return size >= kHugePageSize && (m_huge_pages != ML_HUGE_PAGES_NONE || m_numa_node_mask != 0);
+#else
+    (void)size;
+    return false;
+#endif
+}
+
+void* BufferPool::AllocateMemory(size_t size)
+{
+    if (IsPageMapped(size))
+    {
+        return MapPages((size + kHugePageSize - 1) / kHugePageSize * kHugePageSize);
+    }
+
+    return tensorflow::port::AlignedMalloc(size, kAlignment);
+}
+
+void BufferPool::FreeMemory(void* data, size_t size)
+{
+#ifdef __linux__
+    if (IsPageMapped(size))
+    {
+        munmap(data, (size + kHugePageSize - 1) / kHugePageSize * kHugePageSize);
+        return;
+    }
+#endif
+
+    tensorflow::port::AlignedFree(data);
+}
+
+void* BufferPool::MapPages(size_t size)
+{
+#ifdef __linux__
+    void* data = MAP_FAILED;
+
+    if (m_huge_pages == ML_HUGE_PAGES_EXPLICIT)
+    {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (data == MAP_FAILED && m_huge_pages != ML_HUGE_PAGES_NONE)
+    {
+        // A huge page more is mapped and the ends are unmapped,
+        // so the buffer is covered by whole huge pages
+        size_t mapped_size = size + kHugePageSize;
+        auto mapping = static_cast<char*>(mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (mapping == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        auto address = reinterpret_cast<uintptr_t>(mapping);
+        auto buffer = mapping + ((address + kHugePageSize - 1) & ~(kHugePageSize - 1)) - address;
+        size_t head = buffer - mapping;
+
+        if (head != 0)
+        {
+            munmap(mapping, head);
+        }
+        munmap(buffer + size, kHugePageSize - head);
+
+        // Only a hint, the pages stay regular if the system disables them
+        madvise(buffer, size, MADV_HUGEPAGE);
+        data = buffer;
+    }
+    else if (data == MAP_FAILED)
+    {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            return nullptr;
+        }
+    }
+
+    // The policy is set before the pages are touched, so they are allocated
+    // on the nodes. A single node is preferred rather than required, so the
+    // allocation does not fail if the node is out of memory.
+    if (m_numa_node_mask != 0)
+    {
+        unsigned long node_mask = static_cast<unsigned long>(m_numa_node_mask);
+        int mode = (node_mask & (node_mask - 1)) != 0 ? MPOL_INTERLEAVE : MPOL_PREFERRED;
+        if (syscall(SYS_mbind, data, size, mode, &node_mask, sizeof(node_mask) * 8 + 1, 0) != 0)
+        {
+            // E.g. a node not present in the system
+            int error = errno;
+            munmap(data, size);
+            throw std::runtime_error("Error placing " + std::to_string(size) + " bytes on NUMA node mask " +
+                                     std::to_string(m_numa_node_mask) + ": " + std::strerror(error));
+        }
+    }
+
+    return data;
+#else
+    (void)size;
+    return nullptr;
+#endif
+}
+
+} // namespace ML
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "model_runner.h"
+
+#include "tensorflow/core/framework/tensor.h"
+
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace ML {
+
+/**
+ * Cache of aligned image buffers grouped in size classes. A released buffer
+ * is reused by the next image of its class, so images of the same size
+ * created every frame neither allocate nor fault in new memory.
+ * Buffer contents are not initialized. Large buffers may be backed
+ * by huge pages and placed on given NUMA nodes.
+ */
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+public:
+    static constexpr size_t kAlignment = 64;
+    static constexpr size_t kHugePageSize = 2 << 20;
+
+    // The default pool size keeps a few buffers of the largest size in use
+    static constexpr size_t kDefaultPoolSizeFactor = 4;
+    static constexpr size_t kMinDefaultPoolSize = 64 << 20;
+
+    // Released buffers exceeding ml_context_params::image_pool_size bytes
+    // in total, or the default cap, are freed in the release order
+    explicit BufferPool(const ml_context_params& params);
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    ~BufferPool();
+
+    // Returns a buffer with a single reference, it goes back to the pool
+    // when the last tensor using it is destroyed. The pool must be owned
+    // by a shared pointer, buffers keep it alive.
+    tensorflow::TensorBuffer* Allocate(size_t size);
+
+    // Creates an uninitialized tensor with a pooled buffer
+    tensorflow::Tensor AllocateTensor(tensorflow::DataType dtype, const tensorflow::TensorShape& shape);
+
+    // Frees all pooled buffers
+    void Trim();
+
+    void GetStats(ml_image_pool_stats* stats) const;
+
+private:
+    class Buffer;
+
+    struct FreeBuffer
+    {
+        void* data;
+        size_t size;
+    };
+
+    typedef std::list<FreeBuffer> FreeList;
+
+    static size_t GetSizeClass(size_t size);
+    void Release(void* data, size_t size);
+    size_t GetMaxPooledSize() const;
+
+    // Large buffers are mapped separately to apply the page options
+    bool IsPageMapped(size_t size) const;
+    void* AllocateMemory(size_t size);
+    void FreeMemory(void* data, size_t size);
+    void* MapPages(size_t size);
+
+    size_t m_max_pooled_size; // 0 for the default cap
+    size_t m_max_buffer_size = 0;
+    ml_huge_pages m_huge_pages;
+    unsigned long long m_numa_node_mask;
+    mutable std::mutex m_mutex;
+
+    // Released buffers, the most recent first, and their positions
+    // by size class in the release order
+    FreeList m_free_list;
+    std::map<size_t, std::deque<FreeList::iterator>> m_free_buffers;
+    ml_image_pool_stats m_stats = {};
+};
+
+} // namespace ML
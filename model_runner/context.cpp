@@ -17,13 +17,52 @@ Context* Context::FromHandle(ml_context context)
     return reinterpret_cast<Context*>(context);
 }
 
+Context::Context(ml_context_params const* params)
+    : m_params()
+{
+    if (params != nullptr)
+    {
+        m_params = *params;
+    }
+
+    m_buffer_pool = std::make_shared<BufferPool>(m_params);
+}
+
+std::string Context::GetThreadPoolName(size_t inter_op_threads)
+{
+    return "ml_inter_op_" + std::to_string(inter_op_threads);
+}
+
+const ml_context_params& Context::GetParams() const
+{
+    return m_params;
+}
+
 ml_image Context::CreateImage(ml_image_info const* info)
 {
     m_error_cache.str("");
 
     try
     {
-        return Image::MakeHandle(new Image(info));
+        return Image::MakeHandle(new Image(info, *m_buffer_pool));
+    }
+    catch (std::exception& e)
+    {
+        m_error_cache << e.what();
+        return ML_INVALID_HANDLE;
+    }
+}
+
+ml_image Context::CreateImageFromMemory(ml_image_info const* info,
+                                        void* data,
+                                        size_t row_pitch,
+                                        ml_image_deleter deleter)
+{
+    m_error_cache.str("");
+
+    try
+    {
+        return Image::MakeHandle(new Image(info, data, row_pitch, deleter));
     }
     catch (std::exception& e)
     {
@@ -39,7 +78,7 @@ ml_model Context::CreateModel(ml_model_params const* params)
 
     try
     {
-        return Model::MakeHandle(new Model(params));
+        return Model::MakeHandle(new Model(params, *this));
     }
     catch (std::exception& e)
     {
@@ -53,14 +92,54 @@ char* Context::GetError(char* buffer, size_t buffer_size) const
     return FillBuffer(buffer, buffer_size, m_error_cache.str());
 }
 
+BufferPool& Context::GetBufferPool()
+{
+    return *m_buffer_pool;
+}
+
+std::shared_ptr<ModelData> Context::FindModelData(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_model_data_mutex);
+
+    auto data = m_model_data.find(key);
+    return data != m_model_data.end() ? data->second.lock() : nullptr;
+}
+
+std::shared_ptr<ModelData> Context::AddModelData(const std::string& key,
+                                                 std::shared_ptr<ModelData> data)
+{
+    std::lock_guard<std::mutex> lock(m_model_data_mutex);
+
+    // Forget the models released since
+    for (auto iter = m_model_data.begin(); iter != m_model_data.end();)
+    {
+        iter = iter->second.expired() ? m_model_data.erase(iter) : std::next(iter);
+    }
+
+    // A model loaded concurrently by another thread takes precedence
+    auto& cached_data = m_model_data[key];
+    if (auto existing_data = cached_data.lock())
+    {
+        return existing_data;
+    }
+
+    cached_data = data;
+    return data;
+}
+
 } // namespace ML
 
 
 ml_context mlCreateContext()
+{
+    return mlCreateContextWithParams(nullptr);
+}
+
+ml_context mlCreateContextWithParams(ml_context_params const* params)
 {
     try
     {
-        return ML::Context::MakeHandle(new ML::Context);
+        return ML::Context::MakeHandle(new ML::Context(params));
     }
     catch (...)
     {
@@ -78,6 +157,25 @@ char* mlGetContextError(ml_context context, char* buffer, size_t buffer_size)
     return ML::Context::FromHandle(context)->GetError(buffer, buffer_size);
 }
 
+ml_status mlGetImagePoolStats(ml_context context, ml_image_pool_stats* stats)
+{
+    if (ML::Context::FromHandle(context) == nullptr || stats == nullptr)
+    {
+        return ML_FAIL;
+    }
+
+    ML::Context::FromHandle(context)->GetBufferPool().GetStats(stats);
+    return ML_OK;
+}
+
+void mlTrimImagePool(ml_context context)
+{
+    if (ML::Context::FromHandle(context) != nullptr)
+    {
+        ML::Context::FromHandle(context)->GetBufferPool().Trim();
+    }
+}
+
 
 ml_image mlCreateImage(ml_context context, ml_image_info const* info)
 {
@@ -89,6 +187,20 @@ ml_image mlCreateImage(ml_context context, ml_image_info const* info)
     return ML::Context::FromHandle(context)->CreateImage(info);
 }
 
+ml_image mlCreateImageFromMemory(ml_context context,
+                                 ml_image_info const* info,
+                                 void* data,
+                                 size_t row_pitch,
+                                 ml_image_deleter deleter)
+{
+    if (ML::Context::FromHandle(context) == nullptr)
+    {
+        return ML_INVALID_HANDLE;
+    }
+
+    return ML::Context::FromHandle(context)->CreateImageFromMemory(info, data, row_pitch, deleter);
+}
+
 ml_model mlCreateModel(ml_context context, ml_model_params const* params)
 {
     if (ML::Context::FromHandle(context) == ML_INVALID_HANDLE)
@@ -2,13 +2,20 @@
 
 #include "model_runner.h"
 
-#include <sstream>
+#include "buffer_pool.h"
+#include "utils.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 
 
 namespace ML {
 
 class Image;
 class Model;
+struct ModelData;
 
 class Context
 {
@@ -16,12 +23,34 @@ public:
     static ml_context MakeHandle(Context* context);
     static Context* FromHandle(ml_context context);
 
+    explicit Context(ml_context_params const* params);
+
+    // TensorFlow keeps named pools for the whole process lifetime,
+    // so models and contexts with the same pool size reuse the same pool
+    static std::string GetThreadPoolName(size_t inter_op_threads);
+
+    const ml_context_params& GetParams() const;
+
     ml_image CreateImage(ml_image_info const* info);
+    ml_image CreateImageFromMemory(ml_image_info const* info,
+                                   void* data,
+                                   size_t row_pitch,
+                                   ml_image_deleter deleter);
     ml_model CreateModel(ml_model_params const* params);
     char* GetError(char* buffer, size_t buffer_size) const;
+    BufferPool& GetBufferPool();
+
+    // Loaded models are kept while they are in use, so loading the same
+    // model again returns the existing data
+    std::shared_ptr<ModelData> FindModelData(const std::string& key);
+    std::shared_ptr<ModelData> AddModelData(const std::string& key, std::shared_ptr<ModelData> data);
 
 private:
-    std::ostringstream m_error_cache;
+    ml_context_params m_params;
+    std::shared_ptr<BufferPool> m_buffer_pool; // Kept alive by images using it
+    std::mutex m_model_data_mutex;
+    std::map<std::string, std::weak_ptr<ModelData>> m_model_data;
+    ThreadErrorCache m_error_cache;
 };
 
 } // namespace ML
@@ -0,0 +1,717 @@
+#include "convert.h"
+
+#include "dtype.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ML_HAS_X86_INTRINSICS 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define ML_HAS_X86_INTRINSICS 0
+#endif
+
+// SSE2 is a part of the x86-64 baseline, so no runtime dispatch is needed
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ML_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define ML_HAS_SSE2 0
+#endif
+
+// Functions using F16C are compiled for the extension explicitly
+// and only called if it is supported at runtime
+#if ML_HAS_X86_INTRINSICS && defined(__GNUC__)
+#define ML_TARGET_F16C __attribute__((target("avx,f16c")))
+#else
+#define ML_TARGET_F16C
+#endif
+
+
+namespace tf = tensorflow;
+
+namespace {
+
+typedef void (*FloatToHalfFunc)(const float* src, Eigen::half* dst, size_t count);
+typedef void (*HalfToFloatFunc)(const Eigen::half* src, float* dst, size_t count);
+
+void FloatToHalfScalar(const float* src, Eigen::half* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[i] = Eigen::half(src[i]);
+    }
+}
+
+void HalfToFloatScalar(const Eigen::half* src, float* dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[i] = static_cast<float>(src[i]);
+    }
+}
+
+#if ML_HAS_X86_INTRINSICS
+
+constexpr size_t kVectorSize = 8;
+
+ML_TARGET_F16C void FloatToHalfF16C(const float* src, Eigen::half* dst, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + kVectorSize <= count; i += kVectorSize)
+    {
+        __m256 value = _mm256_loadu_ps(src + i);
+        __m128i result = _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+    }
+
+    // The tail is converted through a temporary vector, so the results
+    // do not depend on the element position
+    if (i < count)
+    {
+        alignas(32) float src_tail[kVectorSize] = {};
+        alignas(16) Eigen::half dst_tail[kVectorSize];
+
+        std::copy(src + i, src + count, src_tail);
+        __m128i result = _mm256_cvtps_ph(_mm256_load_ps(src_tail), _MM_FROUND_TO_NEAREST_INT);
+        _mm_store_si128(reinterpret_cast<__m128i*>(dst_tail), result);
+        std::copy(dst_tail, dst_tail + (count - i), dst + i);
+    }
+}
+
+ML_TARGET_F16C void HalfToFloatF16C(const Eigen::half* src, float* dst, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + kVectorSize <= count; i += kVectorSize)
+    {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(value));
+    }
+
+    if (i < count)
+    {
+        alignas(16) Eigen::half src_tail[kVectorSize] = {};
+        alignas(32) float dst_tail[kVectorSize];
+
+        std::copy(src + i, src + count, src_tail);
+        __m256 result = _mm256_cvtph_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(src_tail)));
+        _mm256_store_ps(dst_tail, result);
+        std::copy(dst_tail, dst_tail + (count - i), dst + i);
+    }
+}
+
+bool HasF16C()
+{
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+
+    bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    bool has_avx = (info[2] & (1 << 28)) != 0;
+    bool has_f16c = (info[2] & (1 << 29)) != 0;
+
+    // The OS must save the AVX registers on context switches
+    return has_osxsave && has_avx && has_f16c && (_xgetbv(0) & 6) == 6;
+#else
+    return false;
+#endif
+}
+
+#endif // ML_HAS_X86_INTRINSICS
+
+FloatToHalfFunc GetFloatToHalf()
+{
+#if ML_HAS_X86_INTRINSICS
+    static const FloatToHalfFunc func = HasF16C() ? FloatToHalfF16C : FloatToHalfScalar;
+    return func;
+#else
+    return FloatToHalfScalar;
+#endif
+}
+
+HalfToFloatFunc GetHalfToFloat()
+{
+#if ML_HAS_X86_INTRINSICS
+    static const HalfToFloatFunc func = HasF16C() ? HalfToFloatF16C : HalfToFloatScalar;
+    return func;
+#else
+    return HalfToFloatScalar;
+#endif
+}
+
+constexpr float kUint8Scale = 255.f;
+
+void Uint8ToFloat(const uint8_t* src, float* dst, size_t count)
+{
+    size_t i = 0;
+
+#if ML_HAS_SSE2
+    const __m128 scale = _mm_set1_ps(1.f / kUint8Scale);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i low = _mm_unpacklo_epi8(value, zero);
+        __m128i high = _mm_unpackhi_epi8(value, zero);
+
+        __m128i parts[] = {
+            _mm_unpacklo_epi16(low, zero),
+            _mm_unpackhi_epi16(low, zero),
+            _mm_unpacklo_epi16(high, zero),
+            _mm_unpackhi_epi16(high, zero),
+        };
+
+        for (size_t j = 0; j < 4; j++)
+        {
+            _mm_storeu_ps(dst + i + j * 4, _mm_mul_ps(_mm_cvtepi32_ps(parts[j]), scale));
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i] = src[i] * (1.f / kUint8Scale);
+    }
+}
+
+// Values are clamped to [0, 1] and rounded to nearest, NaNs become 0
+void FloatToUint8(const float* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+
+#if ML_HAS_SSE2
+    const __m128 scale = _mm_set1_ps(kUint8Scale);
+    const __m128 min_value = _mm_setzero_ps();
+    const __m128 max_value = _mm_set1_ps(kUint8Scale);
+
+    auto convert = [&](const float* data)
+    {
+        // max returns its second operand if either one is NaN, so NaNs are
+        // clamped to 0. The operand order of max must be kept for this.
+        __m128 value = _mm_mul_ps(_mm_loadu_ps(data), scale);
+        value = _mm_min_ps(_mm_max_ps(value, min_value), max_value);
+        return _mm_cvtps_epi32(value);
+    };
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i low = _mm_packs_epi32(convert(src + i), convert(src + i + 4));
+        __m128i high = _mm_packs_epi32(convert(src + i + 8), convert(src + i + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        float value = src[i] * kUint8Scale;
+        value = value > 0.f ? value : 0.f;
+        value = value < kUint8Scale ? value : kUint8Scale;
+        dst[i] = static_cast<uint8_t>(std::lrint(value));
+    }
+}
+
+void ToFloat(tf::DataType type, const void* src, float* dst, size_t count)
+{
+    switch (type)
+    {
+        case tf::DT_FLOAT:
+            std::memcpy(dst, src, count * sizeof(float));
+            break;
+
+        case tf::DT_HALF:
+            GetHalfToFloat()(static_cast<const Eigen::half*>(src), dst, count);
+            break;
+
+        case tf::DT_UINT8:
+            Uint8ToFloat(static_cast<const uint8_t*>(src), dst, count);
+            break;
+
+        default:
+            throw std::runtime_error("Unsupported conversion from " + tf::DataTypeString(type));
+    }
+}
+
+void FromFloat(const float* src, tf::DataType type, void* dst, size_t count)
+{
+    switch (type)
+    {
+        case tf::DT_FLOAT:
+            std::memcpy(dst, src, count * sizeof(float));
+            break;
+
+        case tf::DT_HALF:
+            GetFloatToHalf()(src, static_cast<Eigen::half*>(dst), count);
+            break;
+
+        case tf::DT_UINT8:
+            FloatToUint8(src, static_cast<uint8_t*>(dst), count);
+            break;
+
+        default:
+            throw std::runtime_error("Unsupported conversion to " + tf::DataTypeString(type));
+    }
+}
+
+// Copies `channels` of each pixel between interleaved rows with the given
+// pixel strides. Specialized for common channel counts, so the inner loop
+// is unrolled and vectorized by the compiler, 0 means a runtime count.
+template<size_t Channels>
+void CopyPixels(const float* src,
+                size_t src_stride,
+                float* dst,
+                size_t dst_stride,
+                size_t width,
+                size_t channels)
+{
+    const size_t count = Channels != 0 ? Channels : channels;
+
+    for (size_t x = 0; x < width; x++, src += src_stride, dst += dst_stride)
+    {
+        for (size_t c = 0; c < count; c++)
+        {
+            dst[c] = src[c];
+        }
+    }
+}
+
+// Planar rows are copied the same way with swapped strides
+template<size_t Channels>
+void CopyPlanes(const float* src,
+                size_t src_pixel_stride,
+                size_t src_channel_stride,
+                float* dst,
+                size_t dst_pixel_stride,
+                size_t dst_channel_stride,
+                size_t width,
+                size_t channels)
+{
+    const size_t count = Channels != 0 ? Channels : channels;
+
+    for (size_t c = 0; c < count; c++)
+    {
+        auto src_channel = src + c * src_channel_stride;
+        auto dst_channel = dst + c * dst_channel_stride;
+
+        for (size_t x = 0; x < width; x++)
+        {
+            dst_channel[x * dst_pixel_stride] = src_channel[x * src_pixel_stride];
+        }
+    }
+}
+
+void CopyRowChannels(const float* src,
+                     size_t src_stride,
+                     float* dst,
+                     size_t dst_stride,
+                     size_t width,
+                     size_t channels)
+{
+    switch (channels)
+    {
+        case 1:
+            CopyPixels<1>(src, src_stride, dst, dst_stride, width, channels);
+            break;
+
+        case 3:
+            CopyPixels<3>(src, src_stride, dst, dst_stride, width, channels);
+            break;
+
+        case 4:
+            CopyPixels<4>(src, src_stride, dst, dst_stride, width, channels);
+            break;
+
+        default:
+            CopyPixels<0>(src, src_stride, dst, dst_stride, width, channels);
+            break;
+    }
+}
+
+void CopyRowPlanes(const float* src,
+                   size_t src_pixel_stride,
+                   size_t src_channel_stride,
+                   float* dst,
+                   size_t dst_pixel_stride,
+                   size_t dst_channel_stride,
+                   size_t width,
+                   size_t channels)
+{
+    switch (channels)
+    {
+        case 1:
+            CopyPlanes<1>(src, src_pixel_stride, src_channel_stride,
+                          dst, dst_pixel_stride, dst_channel_stride, width, channels);
+            break;
+
+        case 3:
+            CopyPlanes<3>(src, src_pixel_stride, src_channel_stride,
+                          dst, dst_pixel_stride, dst_channel_stride, width, channels);
+            break;
+
+        case 4:
+            CopyPlanes<4>(src, src_pixel_stride, src_channel_stride,
+                          dst, dst_pixel_stride, dst_channel_stride, width, channels);
+            break;
+
+        default:
+            CopyPlanes<0>(src, src_pixel_stride, src_channel_stride,
+                          dst, dst_pixel_stride, dst_channel_stride, width, channels);
+            break;
+    }
+}
+
+// Returns the image data pointer, checking the image tensor holds all rows
+char* GetImageData(const ML::Image& image)
+{
+    auto data = image.GetTensor().tensor_data();
+    if (data.size() < (image.GetRowCount() - 1) * image.GetRowPitch() + image.GetRowSize())
+    {
+        throw std::runtime_error("Image buffer size does not match the image description");
+    }
+
+    return const_cast<char*>(data.data());
+}
+
+// Converts `height` rows of `count` elements, rows are `pitch` bytes apart
+void ConvertRows(tf::DataType src_type,
+                 const char* src,
+                 size_t src_pitch,
+                 tf::DataType dst_type,
+                 char* dst,
+                 size_t dst_pitch,
+                 size_t count,
+                 size_t height)
+{
+    if (src_pitch == count * tf::DataTypeSize(src_type) &&
+        dst_pitch == count * tf::DataTypeSize(dst_type))
+    {
+        ML::ConvertData(src_type, src, dst_type, dst, count * height);
+        return;
+    }
+
+    for (size_t y = 0; y < height; y++)
+    {
+        ML::ConvertData(src_type, src + y * src_pitch, dst_type, dst + y * dst_pitch, count);
+    }
+}
+
+/**
+ * Image rows converted to and from interleaved float rows of all image
+ * channels. Planar images are gathered from and scattered into the planes.
+ */
+class RowConverter
+{
+public:
+    explicit RowConverter(const ML::Image& image)
+        : m_data(GetImageData(image))
+        , m_row_pitch(image.GetRowPitch())
+    {
+        image.GetInfo(&m_info);
+        m_dtype = ML::DataTypeToTF(m_info.dtype);
+
+        if (m_info.layout == ML_LAYOUT_CHW)
+        {
+            m_planes.resize(m_info.width * m_info.channels);
+        }
+    }
+
+    void Load(size_t y, float* row)
+    {
+        if (m_info.layout == ML_LAYOUT_HWC)
+        {
+            ToFloat(m_dtype, m_data + y * m_row_pitch, row, m_info.width * m_info.channels);
+            return;
+        }
+
+        for (size_t c = 0; c < m_info.channels; c++)
+        {
+            ToFloat(m_dtype, m_data + GetPlaneRowOffset(c, y),
+                    m_planes.data() + c * m_info.width, m_info.width);
+        }
+
+        CopyRowPlanes(m_planes.data(), 1, m_info.width,
+                      row, m_info.channels, 1, m_info.width, m_info.channels);
+    }
+
+    void Store(size_t y, const float* row)
+    {
+        if (m_info.layout == ML_LAYOUT_HWC)
+        {
+            FromFloat(row, m_dtype, m_data + y * m_row_pitch, m_info.width * m_info.channels);
+            return;
+        }
+
+        CopyRowPlanes(row, m_info.channels, 1,
+                      m_planes.data(), 1, m_info.width, m_info.width, m_info.channels);
+
+        for (size_t c = 0; c < m_info.channels; c++)
+        {
+            FromFloat(m_planes.data() + c * m_info.width, m_dtype,
+                      m_data + GetPlaneRowOffset(c, y), m_info.width);
+        }
+    }
+
+private:
+    size_t GetPlaneRowOffset(size_t channel, size_t y) const
+    {
+        return (channel * m_info.height + y) * m_row_pitch;
+    }
+
+    ml_image_info m_info;
+    tf::DataType m_dtype;
+    char* m_data;
+    size_t m_row_pitch;
+    std::vector<float> m_planes;
+};
+
+// Checks image rows are contiguous rows of a tensor with the given channels
+bool IsInterleaved(const ml_image_info& info, size_t channels)
+{
+    return info.channels == channels && (info.layout == ML_LAYOUT_HWC || channels == 1);
+}
+
+void ValidateTensor(const ml_image_info& info, const tf::Tensor& tensor)
+{
+    if (tensor.dims() != 4 ||
+        static_cast<size_t>(tensor.dim_size(1)) != info.height ||
+        static_cast<size_t>(tensor.dim_size(2)) != info.width)
+    {
+        throw std::runtime_error("Tensor shape " + tensor.shape().DebugString()
+                                 + " does not match the image description");
+    }
+}
+
+} // namespace
+
+
+namespace ML {
+
+void ConvertData(tf::DataType src_type,
+                 const void* src,
+                 tf::DataType dst_type,
+                 void* dst,
+                 size_t count)
+{
+    if (src_type == dst_type)
+    {
+        std::memcpy(dst, src, count * tf::DataTypeSize(src_type));
+    }
+    else if (src_type == tf::DT_FLOAT && dst_type == tf::DT_HALF)
+    {
+        GetFloatToHalf()(static_cast<const float*>(src), static_cast<Eigen::half*>(dst), count);
+    }
+    else if (src_type == tf::DT_HALF && dst_type == tf::DT_FLOAT)
+    {
+        GetHalfToFloat()(static_cast<const Eigen::half*>(src), static_cast<float*>(dst), count);
+    }
+    else if (src_type == tf::DT_FLOAT)
+    {
+        FromFloat(static_cast<const float*>(src), dst_type, dst, count);
+    }
+    else if (dst_type == tf::DT_FLOAT)
+    {
+        ToFloat(src_type, src, static_cast<float*>(dst), count);
+    }
+    else
+    {
+        // Other types are converted through float in chunks
+        constexpr size_t kChunkSize = 1024;
+        float chunk[kChunkSize];
+
+        size_t src_size = tf::DataTypeSize(src_type);
+        size_t dst_size = tf::DataTypeSize(dst_type);
+
+        for (size_t i = 0; i < count; i += kChunkSize)
+        {
+            size_t chunk_count = std::min(kChunkSize, count - i);
+            ToFloat(src_type, static_cast<const char*>(src) + i * src_size, chunk, chunk_count);
+            FromFloat(chunk, dst_type, static_cast<char*>(dst) + i * dst_size, chunk_count);
+        }
+    }
+}
+
+void ConvertTensor(const tf::Tensor& src, tf::Tensor& dst)
+{
+    if (src.NumElements() != dst.NumElements())
+    {
+        throw std::runtime_error("Tensor element counts do not match: "
+                                 + src.shape().DebugString() + " vs " + dst.shape().DebugString());
+    }
+
+    ConvertData(src.dtype(), src.tensor_data().data(),
+                dst.dtype(), const_cast<char*>(dst.tensor_data().data()),
+                src.NumElements());
+}
+
+bool IsTensorLayout(const Image& image, tf::DataType dtype, size_t channels)
+{
+    ml_image_info info;
+    image.GetInfo(&info);
+
+    return DataTypeToTF(info.dtype) == dtype && IsInterleaved(info, channels) && image.IsContiguous();
+}
+
+void ConvertImageToTensor(const Image& image, tf::Tensor& tensor, size_t tensor_channel)
+{
+    ml_image_info info;
+    image.GetInfo(&info);
+
+    ValidateTensor(info, tensor);
+
+    size_t tensor_channels = tensor.dim_size(3);
+    if (tensor_channel >= tensor_channels)
+    {
+        throw std::runtime_error("Bad tensor channel " + std::to_string(tensor_channel));
+    }
+
+    size_t channels = std::min(info.channels, tensor_channels - tensor_channel);
+    size_t row_count = info.width * tensor_channels;
+    size_t row_size = row_count * tf::DataTypeSize(tensor.dtype());
+    auto dst = const_cast<char*>(tensor.tensor_data().data());
+
+    if (channels == tensor_channels && IsInterleaved(info, channels))
+    {
+        // Only the data type and the row pitch may differ
+        ConvertRows(DataTypeToTF(info.dtype), GetImageData(image), image.GetRowPitch(),
+                    tensor.dtype(), dst, row_size, row_count, info.height);
+        return;
+    }
+
+    RowConverter converter(image);
+    std::vector<float> image_row(info.width * info.channels);
+
+    if (channels == tensor_channels)
+    {
+        std::vector<float> tensor_row(row_count);
+
+        for (size_t y = 0; y < info.height; y++)
+        {
+            converter.Load(y, image_row.data());
+            CopyRowChannels(image_row.data(), info.channels,
+                            tensor_row.data(), tensor_channels, info.width, channels);
+            FromFloat(tensor_row.data(), tensor.dtype(), dst + y * row_size, row_count);
+        }
+        return;
+    }
+
+    // Only the channels of the image are written, the other tensor channels
+    // are left to the other images packed into the tensor
+    size_t element_size = tf::DataTypeSize(tensor.dtype());
+    size_t pixel_size = channels * element_size;
+    size_t tensor_pixel_size = tensor_channels * element_size;
+    std::vector<float> channel_row(info.width * channels);
+    std::vector<char> converted_row(info.width * pixel_size);
+
+    for (size_t y = 0; y < info.height; y++)
+    {
+        converter.Load(y, image_row.data());
+        auto tensor_row = dst + y * row_size + tensor_channel * element_size;
+
+        if (tensor.dtype() == tf::DT_FLOAT)
+        {
+            CopyRowChannels(image_row.data(), info.channels,
+                            reinterpret_cast<float*>(tensor_row), tensor_channels, info.width, channels);
+            continue;
+        }
+
+        CopyRowChannels(image_row.data(), info.channels,
+                        channel_row.data(), channels, info.width, channels);
+        FromFloat(channel_row.data(), tensor.dtype(), converted_row.data(), channel_row.size());
+
+        for (size_t x = 0; x < info.width; x++)
+        {
+            std::memcpy(tensor_row + x * tensor_pixel_size, converted_row.data() + x * pixel_size, pixel_size);
+        }
+    }
+}
+
+void ConvertTensorToImage(const tf::Tensor& tensor, Image& image)
+{
+    ml_image_info info;
+    image.GetInfo(&info);
+
+    ValidateTensor(info, tensor);
+
+    size_t channels = tensor.dim_size(3);
+    if (channels > info.channels)
+    {
+        throw std::runtime_error("Tensor has more channels than the image: "
+                                 + std::to_string(channels));
+    }
+
+    size_t row_count = info.width * channels;
+    size_t row_size = row_count * tf::DataTypeSize(tensor.dtype());
+    auto src = tensor.tensor_data().data();
+
+    if (IsInterleaved(info, channels))
+    {
+        ConvertRows(tensor.dtype(), src, row_size, DataTypeToTF(info.dtype),
+                    GetImageData(image), image.GetRowPitch(), row_count, info.height);
+        return;
+    }
+
+    RowConverter converter(image);
+    std::vector<float> image_row(info.width * info.channels);
+    std::vector<float> tensor_row(row_count);
+
+    for (size_t y = 0; y < info.height; y++)
+    {
+        // The remaining image channels are loaded to be stored back intact
+        if (info.channels > channels)
+        {
+            converter.Load(y, image_row.data());
+        }
+
+        ToFloat(tensor.dtype(), src + y * row_size, tensor_row.data(), row_count);
+        CopyRowChannels(tensor_row.data(), channels,
+                        image_row.data(), info.channels, info.width, channels);
+        converter.Store(y, image_row.data());
+    }
+}
+
+void CopyImageChannels(const Image& src,
+                       size_t src_channel,
+                       Image& dst,
+                       size_t dst_channel,
+                       size_t count)
+{
+    ml_image_info src_info;
+    ml_image_info dst_info;
+    src.GetInfo(&src_info);
+    dst.GetInfo(&dst_info);
+
+    if (src_info.width != dst_info.width || src_info.height != dst_info.height ||
+        src_channel + count > src_info.channels || dst_channel + count > dst_info.channels)
+    {
+        throw std::runtime_error("Image channels do not match");
+    }
+
+    RowConverter src_converter(src);
+    RowConverter dst_converter(dst);
+    std::vector<float> src_row(src_info.width * src_info.channels);
+    std::vector<float> dst_row(dst_info.width * dst_info.channels);
+
+    for (size_t y = 0; y < src_info.height; y++)
+    {
+        src_converter.Load(y, src_row.data());
+        dst_converter.Load(y, dst_row.data());
+        CopyRowChannels(src_row.data() + src_channel, src_info.channels,
+                        dst_row.data() + dst_channel, dst_info.channels, src_info.width, count);
+        dst_converter.Store(y, dst_row.data());
+    }
+}
+
+} // namespace ML
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "image.h"
+#include "model_runner.h"
+
+#include "tensorflow/core/framework/tensor.h"
+
+#include <cstddef>
+
+
+namespace ML {
+
+// Converts `count` elements between float, half and normalized uint8 data,
+// the data is copied as is if the types match. Float and half conversions
+// are vectorized with F16C if the CPU supports it.
+void ConvertData(tensorflow::DataType src_type,
+                 const void* src,
+                 tensorflow::DataType dst_type,
+                 void* dst,
+                 size_t count);
+
+// Converts tensor data, the tensors must have the same number of elements
+void ConvertTensor(const tensorflow::Tensor& src, tensorflow::Tensor& dst);
+
+// Checks an image buffer may be used as a (1, height, width, channels)
+// tensor of the given type without conversion
+bool IsTensorLayout(const Image& image, tensorflow::DataType dtype, size_t channels);
+
+// Converts image data into a (1, height, width, channels) tensor starting
+// from `tensor_channel`, so several images may be packed into one tensor.
+// Image channels not fitting the tensor are skipped, the other tensor
+// channels are not accessed.
+void ConvertImageToTensor(const Image& image,
+                          tensorflow::Tensor& tensor,
+                          size_t tensor_channel = 0);
+
+// Converts a (1, height, width, channels) tensor into image data,
+// image channels beyond the tensor channel count are kept
+void ConvertTensorToImage(const tensorflow::Tensor& tensor, Image& image);
+
+// Copies `count` channels starting from `src_channel` of one image
+// into the channels starting from `dst_channel` of another one,
+// the images must have the same width and height
+void CopyImageChannels(const Image& src,
+                       size_t src_channel,
+                       Image& dst,
+                       size_t dst_channel,
+                       size_t count);
+
+} // namespace ML
@@ -0,0 +1,42 @@
+#include "arg_parser.h"
+
+#include "tensorflow/contrib/util/convert_graphdef_memmapped_format_lib.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+
+int main(int argc, char* argv[])
+try
+{
+    ArgParser parser;
+
+    std::string input_path;
+    parser.AddArg(&input_path, "i", "Path to TensorFlow model (protobuf format)");
+
+    std::string output_path;
+    parser.AddArg(&output_path, "o", "Path to the converted model (memmapped format)");
+
+    int min_size = 1024;
+    parser.AddArg(&min_size, "min_size",
+                  "Minimum size of constants mapped from the file, in bytes, 1024 if omitted",
+                  true);
+
+    parser.Parse(argc, argv);
+
+    std::cerr << "Converting " << input_path << " to " << output_path << "\n";
+
+    // Constants are stored aligned in the package and replaced
+    // with ImmutableConst operations referencing them
+    auto status = tensorflow::ConvertConstantsToImmutable(input_path, output_path, min_size);
+    if (!status.ok())
+    {
+        throw std::runtime_error("Conversion error: " + status.ToString());
+    }
+}
+catch (std::exception& e)
+{
+    std::cerr << e.what() << std::endl;
+    return -1;
+}
@@ -17,6 +17,9 @@ inline tensorflow::DataType DataTypeToTF(ml_data_type type)
         case ML_FLOAT16:
             return tensorflow::DT_HALF;
 
+        case ML_UINT8:
+            return tensorflow::DT_UINT8;
+
         default:
             throw std::runtime_error("Unsupported image data type: " + std::to_string(type));
     }
@@ -32,6 +35,9 @@ inline ml_data_type DataTypeFromTF(tensorflow::DataType type)
         case tensorflow::DT_HALF:
             return ML_FLOAT16;
 
+        case tensorflow::DT_UINT8:
+            return ML_UINT8;
+
         default:
             throw std::runtime_error("Unsupported image data type: " + std::to_string(type));
     }
@@ -47,6 +53,9 @@ inline size_t DataTypeSize(ml_data_type type)
         case ML_FLOAT16:
             return 2;
 
+        case ML_UINT8:
+            return 1;
+
         default:
             throw std::runtime_error("Unsupported image data type: " + std::to_string(type));
     }
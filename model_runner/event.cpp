@@ -0,0 +1,107 @@
+#include "event.h"
+
+#include "utils.h"
+
+
+namespace ML {
+
+ml_event Event::MakeHandle(Event* event)
+{
+    return reinterpret_cast<ml_event>(event);
+}
+
+Event* Event::FromHandle(ml_event event)
+{
+    return reinterpret_cast<Event*>(event);
+}
+
+void Event::Retain()
+{
+    m_ref_count++;
+}
+
+void Event::Release()
+{
+    if (--m_ref_count == 0)
+    {
+        delete this;
+    }
+}
+
+void Event::Complete(ml_status status, std::string error)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_complete = true;
+        m_status = status;
+        m_error = std::move(error);
+    }
+
+    m_condition.notify_all();
+}
+
+ml_event_status Event::GetStatus() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_complete)
+    {
+        return ML_EVENT_PENDING;
+    }
+
+    return m_status == ML_OK ? ML_EVENT_COMPLETE : ML_EVENT_FAILED;
+}
+
+ml_status Event::Wait() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return m_complete; });
+    return m_status;
+}
+
+char* Event::GetError(char* buffer, size_t buffer_size) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return FillBuffer(buffer, buffer_size, m_error);
+}
+
+} // namespace ML
+
+
+ml_event_status mlGetEventStatus(ml_event event)
+{
+    if (ML::Event::FromHandle(event) == nullptr)
+    {
+        return ML_EVENT_FAILED;
+    }
+
+    return ML::Event::FromHandle(event)->GetStatus();
+}
+
+ml_status mlWaitEvent(ml_event event)
+{
+    if (ML::Event::FromHandle(event) == nullptr)
+    {
+        return ML_FAIL;
+    }
+
+    return ML::Event::FromHandle(event)->Wait();
+}
+
+char* mlGetEventError(ml_event event, char* buffer, size_t buffer_size)
+{
+    if (ML::Event::FromHandle(event) == nullptr)
+    {
+        return ML::FillBuffer(buffer, buffer_size, "Bad event handle");
+    }
+
+    return ML::Event::FromHandle(event)->GetError(buffer, buffer_size);
+}
+
+void mlReleaseEvent(ml_event event)
+{
+    if (ML::Event::FromHandle(event) != nullptr)
+    {
+        ML::Event::FromHandle(event)->Release();
+    }
+}
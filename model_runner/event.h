@@ -0,0 +1,43 @@
+#pragma once
+
+#include "model_runner.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+
+namespace ML {
+
+/**
+ * Completion state of an asynchronous operation. The event is reference
+ * counted, so the handle may be released while the operation is pending.
+ */
+class Event
+{
+public:
+    static ml_event MakeHandle(Event* event);
+    static Event* FromHandle(ml_event event);
+
+    Event() = default;
+
+    void Retain();
+    void Release();
+
+    void Complete(ml_status status, std::string error);
+
+    ml_event_status GetStatus() const;
+    ml_status Wait() const;
+    char* GetError(char* buffer, size_t buffer_size) const;
+
+private:
+    std::atomic<int> m_ref_count { 1 };
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_condition;
+    bool m_complete = false;
+    ml_status m_status = ML_FAIL;
+    std::string m_error;
+};
+
+} // namespace ML
@@ -0,0 +1,60 @@
+#include "executor.h"
+
+
+namespace ML {
+
+Executor::~Executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_condition.notify_one();
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void Executor::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_thread.joinable())
+        {
+            m_thread = std::thread(&Executor::Run, this);
+        }
+
+        m_tasks.push_back(std::move(task));
+    }
+
+    m_condition.notify_one();
+}
+
+void Executor::Run()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+
+            if (m_tasks.empty())
+            {
+                return; // Stopped and drained
+            }
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+} // namespace ML
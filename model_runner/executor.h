@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace ML {
+
+/**
+ * Runs tasks one by one in submission order on a worker thread.
+ * The thread is started with the first task. Pending tasks are
+ * finished before the executor is destroyed.
+ */
+class Executor
+{
+public:
+    Executor() = default;
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    ~Executor();
+
+    void Submit(std::function<void()> task);
+
+private:
+    void Run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+} // namespace ML
@@ -0,0 +1,428 @@
+#include "graph_optimizer.h"
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/tools/graph_transforms/transform_graph.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+
+namespace tf = tensorflow;
+
+namespace {
+
+// Operations computed in half precision in the mixed precision mode,
+// the rest are numerically sensitive, e.g. reductions and exponents
+const std::unordered_set<std::string> kMixedPrecisionOps = {
+    "Add",
+    "AddN",
+    "AddV2",
+    "AvgPool",
+    "BiasAdd",
+    "Concat",
+    "ConcatV2",
+    "Conv2D",
+    "Conv2DBackpropInput",
+    "DepthToSpace",
+    "DepthwiseConv2dNative",
+    "Elu",
+    "Identity",
+    "LeakyRelu",
+    "MatMul",
+    "MaxPool",
+    "MirrorPad",
+    "Mul",
+    "Pad",
+    "Relu",
+    "Relu6",
+    "Reshape",
+    "ResizeNearestNeighbor",
+    "Slice",
+    "SpaceToDepth",
+    "StridedSlice",
+    "Sub",
+    "Transpose",
+};
+
+// Operations keeping their data types in any mode
+const std::unordered_set<std::string> kFixedPrecisionOps = {
+    "ImmutableConst", // Data type must match the mapped data
+    "Placeholder",
+    "PlaceholderWithDefault",
+    "VarHandleOp",
+    "Variable",
+    "VariableV2",
+};
+
+// Strips control dependency marks and output indices from an input name
+std::string GetNodeName(const std::string& input)
+{
+    size_t begin = !input.empty() && input[0] == '^' ? 1 : 0;
+    size_t end = input.rfind(':');
+    if (end == std::string::npos || end < begin)
+    {
+        end = input.size();
+    }
+    return input.substr(begin, end - begin);
+}
+
+// Changes float data types of a node to half, returns false if there are none
+bool ConvertNodeToHalf(tf::NodeDef& node)
+{
+    bool converted = false;
+
+    for (auto& attr : *node.mutable_attr())
+    {
+        auto& value = attr.second;
+
+        if (value.value_case() == tf::AttrValue::kType && value.type() == tf::DT_FLOAT)
+        {
+            value.set_type(tf::DT_HALF);
+            converted = true;
+        }
+        else if (value.value_case() == tf::AttrValue::kList)
+        {
+            for (int i = 0; i < value.list().type_size(); i++)
+            {
+                if (value.list().type(i) == tf::DT_FLOAT)
+                {
+                    value.mutable_list()->set_type(i, tf::DT_HALF);
+                    converted = true;
+                }
+            }
+        }
+        else if (value.value_case() == tf::AttrValue::kTensor &&
+                 value.tensor().dtype() == tf::DT_FLOAT)
+        {
+            tf::Tensor tensor;
+            if (!tensor.FromProto(value.tensor()))
+            {
+                return false;
+            }
+
+            tf::Tensor half_tensor(tf::DT_HALF, tensor.shape());
+            auto src = tensor.flat<float>();
+            auto dst = half_tensor.flat<Eigen::half>();
+            for (tf::int64 j = 0; j < src.size(); j++)
+            {
+                dst(j) = Eigen::half(src(j));
+            }
+
+            half_tensor.AsProtoTensorContent(value.mutable_tensor());
+            converted = true;
+        }
+    }
+
+    return converted;
+}
+
+// Checks the node is valid and may run on CPU
+bool IsNodeSupported(const tf::NodeDef& node)
+{
+    const tf::OpDef* op_def;
+    return tf::OpRegistry::Global()->LookUpOpDef(node.op(), &op_def).ok()
+        && tf::ValidateNodeDef(node, *op_def).ok()
+        && tf::FindKernelDef(tf::DeviceType(tf::DEVICE_CPU), node, nullptr, nullptr).ok();
+}
+
+bool GetNodeTypes(const tf::NodeDef& node, tf::DataTypeVector& inputs, tf::DataTypeVector& outputs)
+{
+    const tf::OpDef* op_def;
+    return tf::OpRegistry::Global()->LookUpOpDef(node.op(), &op_def).ok()
+        && tf::InOutTypesForNode(node, *op_def, &inputs, &outputs).ok();
+}
+
+bool IsFloatingPoint(tf::DataType type)
+{
+    return type == tf::DT_FLOAT || type == tf::DT_HALF;
+}
+
+} // namespace
+
+
+namespace ML {
+
+void PruneGraph(const std::vector<std::string>& input_nodes,
+                const std::vector<std::string>& output_nodes,
+                tf::GraphDef& graph_def)
+{
+    std::unordered_map<std::string, const tf::NodeDef*> nodes;
+    for (auto& node : graph_def.node())
+    {
+        nodes.emplace(node.name(), &node);
+    }
+
+    // Only the fan-in of placeholder inputs is cut. Other input nodes still
+    // refer to their inputs even when fed, so the graph would not import
+    // without the nodes upstream of them.
+    std::unordered_set<std::string> used_nodes;
+    std::vector<std::string> pending_nodes(output_nodes.begin(), output_nodes.end());
+
+    for (auto& name : input_nodes)
+    {
+        auto node = nodes.find(name);
+        if (node != nodes.end() && node->second->op() == "Placeholder")
+        {
+            used_nodes.insert(name);
+        }
+        else
+        {
+            pending_nodes.push_back(name);
+        }
+    }
+
+    while (!pending_nodes.empty())
+    {
+        auto name = std::move(pending_nodes.back());
+        pending_nodes.pop_back();
+
+        auto node = nodes.find(name);
+        if (!used_nodes.insert(name).second || node == nodes.end())
+        {
+            continue;
+        }
+
+        for (auto& input : node->second->input())
+        {
+            pending_nodes.push_back(GetNodeName(input));
+        }
+    }
+
+    tf::GraphDef pruned_graph_def;
+    *pruned_graph_def.mutable_versions() = graph_def.versions();
+    *pruned_graph_def.mutable_library() = graph_def.library();
+
+    for (auto& node : graph_def.node())
+    {
+        if (used_nodes.count(node.name()) != 0)
+        {
+            *pruned_graph_def.add_node() = node;
+        }
+    }
+
+    graph_def.Swap(&pruned_graph_def);
+}
+
+tf::Status OptimizeGraph(const std::vector<std::string>& input_nodes,
+                         const std::vector<std::string>& output_nodes,
+                         unsigned optimizations,
+                         tf::GraphDef& graph_def)
+{
+    // Rewritten nodes lose the shapes used to describe model images
+    std::map<std::string, tf::AttrValue> output_shapes;
+    for (auto& node : graph_def.node())
+    {
+        auto shapes = node.attr().find("_output_shapes");
+        if (shapes != node.attr().end())
+        {
+            output_shapes.emplace(node.name(), shapes->second);
+        }
+    }
+
+    if (optimizations & ML_OPTIMIZE_PRUNE)
+    {
+        PruneGraph(input_nodes, output_nodes, graph_def);
+    }
+
+    tf::graph_transforms::TransformParameters transforms;
+
+    if (optimizations & ML_OPTIMIZE_STRIP_IDENTITY)
+    {
+        transforms.push_back({ "remove_nodes", { { "op", { "Identity", "CheckNumerics" } } } });
+    }
+
+    if (optimizations & ML_OPTIMIZE_FOLD_CONSTANTS)
+    {
+        transforms.push_back({ "fold_constants", {
+            { "ignore_errors", { "true" } },
+            { "clear_output_shapes", { "false" } }
+        } });
+    }
+
+    if (optimizations & ML_OPTIMIZE_FOLD_BATCH_NORMS)
+    {
+        transforms.push_back({ "fold_batch_norms", {} });
+        transforms.push_back({ "fold_old_batch_norms", {} });
+    }
+
+    if (!transforms.empty())
+    {
+        auto status = tf::graph_transforms::TransformGraph(input_nodes, output_nodes,
+                                                           transforms, &graph_def);
+        if (!status.ok())
+        {
+            return status;
+        }
+    }
+
+    for (auto& node : *graph_def.mutable_node())
+    {
+        auto shapes = output_shapes.find(node.name());
+        if (shapes != output_shapes.end() && node.attr().count("_output_shapes") == 0)
+        {
+            (*node.mutable_attr())["_output_shapes"] = shapes->second;
+        }
+    }
+
+    return tf::Status::OK();
+}
+
+tf::Status ConvertGraphPrecision(const std::vector<std::string>& input_nodes,
+                                 const std::vector<std::string>& output_nodes,
+                                 ml_precision precision,
+                                 tf::GraphDef& graph_def)
+{
+    if (precision == ML_PRECISION_DEFAULT)
+    {
+        return tf::Status::OK();
+    }
+
+    std::unordered_set<std::string> io_nodes(input_nodes.begin(), input_nodes.end());
+    io_nodes.insert(output_nodes.begin(), output_nodes.end());
+
+    std::unordered_set<std::string> half_nodes;
+
+    auto convert_node = [&half_nodes](tf::NodeDef& node)
+    {
+        tf::NodeDef half_node = node;
+        if (ConvertNodeToHalf(half_node) && IsNodeSupported(half_node))
+        {
+            node.Swap(&half_node);
+            half_nodes.insert(node.name());
+        }
+    };
+
+    // Constants are converted separately in the mixed precision mode
+    for (auto& node : *graph_def.mutable_node())
+    {
+        if (io_nodes.count(node.name()) != 0 || kFixedPrecisionOps.count(node.op()) != 0)
+        {
+            continue;
+        }
+
+        if (precision == ML_PRECISION_MIXED && kMixedPrecisionOps.count(node.op()) == 0)
+        {
+            continue;
+        }
+
+        convert_node(node);
+    }
+
+    std::unordered_map<std::string, tf::NodeDef*> nodes;
+    std::unordered_map<std::string, std::vector<const tf::NodeDef*>> consumers;
+
+    for (auto& node : *graph_def.mutable_node())
+    {
+        nodes.emplace(node.name(), &node);
+
+        for (auto& input : node.input())
+        {
+            consumers[GetNodeName(input)].push_back(&node);
+        }
+    }
+
+    // Constants consumed by half precision operations only
+    // are stored in half precision
+    if (precision == ML_PRECISION_MIXED)
+    {
+        for (auto& node : *graph_def.mutable_node())
+        {
+            if (node.op() != "Const" || io_nodes.count(node.name()) != 0)
+            {
+                continue;
+            }
+
+            auto& node_consumers = consumers[node.name()];
+            bool is_half = !node_consumers.empty() &&
+                std::all_of(node_consumers.begin(), node_consumers.end(),
+                            [&half_nodes](const tf::NodeDef* consumer)
+                            {
+                                return half_nodes.count(consumer->name()) != 0;
+                            });
+
+            if (is_half)
+            {
+                convert_node(node);
+            }
+        }
+    }
+
+    // Insert casts where data types of connected nodes do not match
+    std::map<std::string, tf::NodeDef> casts;
+
+    for (auto& node : *graph_def.mutable_node())
+    {
+        tf::DataTypeVector input_types;
+        tf::DataTypeVector output_types;
+        if (!GetNodeTypes(node, input_types, output_types))
+        {
+            continue;
+        }
+
+        size_t data_input = 0;
+
+        for (int i = 0; i < node.input_size(); i++)
+        {
+            if (node.input(i).empty() || node.input(i)[0] == '^')
+            {
+                continue; // Control dependency
+            }
+
+            auto input_type = data_input < input_types.size() ?
+                input_types[data_input] : tf::DT_INVALID;
+            data_input++;
+
+            tf::TensorId input_id = tf::ParseTensorName(node.input(i));
+            auto producer = nodes.find(std::string(input_id.node()));
+
+            tf::DataTypeVector producer_inputs;
+            tf::DataTypeVector producer_outputs;
+            if (producer == nodes.end() ||
+                !GetNodeTypes(*producer->second, producer_inputs, producer_outputs) ||
+                input_id.index() < 0 ||
+                static_cast<size_t>(input_id.index()) >= producer_outputs.size())
+            {
+                continue;
+            }
+
+            auto output_type = producer_outputs[input_id.index()];
+            if (output_type == input_type ||
+                !IsFloatingPoint(output_type) ||
+                !IsFloatingPoint(input_type))
+            {
+                continue;
+            }
+
+            std::string cast_name = std::string(input_id.node()) + "/ml_cast_"
+                + std::to_string(input_id.index()) + "_" + tf::DataTypeString(input_type);
+
+            auto& cast = casts[cast_name];
+            if (cast.name().empty())
+            {
+                cast.set_name(cast_name);
+                cast.set_op("Cast");
+                cast.set_device(producer->second->device());
+                cast.add_input(node.input(i));
+                (*cast.mutable_attr())["SrcT"].set_type(output_type);
+                (*cast.mutable_attr())["DstT"].set_type(input_type);
+            }
+
+            node.set_input(i, cast_name);
+        }
+    }
+
+    for (auto& cast : casts)
+    {
+        *graph_def.add_node() = std::move(cast.second);
+    }
+
+    return tf::Status::OK();
+}
+
+} // namespace ML
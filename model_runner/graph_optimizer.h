@@ -0,0 +1,34 @@
+#pragma once
+
+#include "model_runner.h"
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+
+#include <string>
+#include <vector>
+
+
+namespace ML {
+
+// Removes the nodes neither computing the outputs nor listed as inputs,
+// nodes upstream of inputs other than placeholders are kept
+void PruneGraph(const std::vector<std::string>& input_nodes,
+                const std::vector<std::string>& output_nodes,
+                tensorflow::GraphDef& graph_def);
+
+// Rewrites a graph according to #ml_graph_optimization flags,
+// the input and output nodes are kept along with their shapes
+tensorflow::Status OptimizeGraph(const std::vector<std::string>& input_nodes,
+                                 const std::vector<std::string>& output_nodes,
+                                 unsigned optimizations,
+                                 tensorflow::GraphDef& graph_def);
+
+// Converts floating point operations of a graph to half precision,
+// the input and output nodes keep their data types
+tensorflow::Status ConvertGraphPrecision(const std::vector<std::string>& input_nodes,
+                                         const std::vector<std::string>& output_nodes,
+                                         ml_precision precision,
+                                         tensorflow::GraphDef& graph_def);
+
+} // namespace ML
@@ -3,10 +3,67 @@
 #include "dtype.h"
 #include "utils.h"
 
+#include "tensorflow/core/framework/allocation_description.pb.h"
+
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 
 
+namespace {
+
+namespace tf = tensorflow;
+
+// Caller-owned memory wrapped into a tensor buffer, so it is fed
+// to a session like any other tensor
+class ExternalBuffer : public tf::TensorBuffer
+{
+public:
+    ExternalBuffer(void* data, size_t size, ml_image_deleter deleter)
+        : tf::TensorBuffer(data)
+        , m_size(size)
+        , m_deleter(deleter)
+    {
+    }
+
+    ~ExternalBuffer() override
+    {
+        if (m_deleter != nullptr)
+        {
+            m_deleter(data());
+        }
+    }
+
+    size_t size() const override
+    {
+        return m_size;
+    }
+
+    tf::TensorBuffer* root_buffer() override
+    {
+        return this;
+    }
+
+    void FillAllocationDescription(tf::AllocationDescription* proto) const override
+    {
+        proto->set_requested_bytes(m_size);
+        proto->set_allocator_name("ml_external");
+    }
+
+    // Prevents TensorFlow from forwarding the memory to op outputs
+    bool OwnsMemory() const override
+    {
+        return false;
+    }
+
+private:
+    size_t m_size;
+    ml_image_deleter m_deleter;
+};
+
+} // namespace
+
+
 namespace ML {
 
 ml_image Image::MakeHandle(Image* image)
@@ -19,15 +76,59 @@ Image* Image::FromHandle(ml_image image)
     return reinterpret_cast<Image*>(image);
 }
 
-Image::Image(ml_image_info const* info)
+Image::Image(ml_image_info const* info, BufferPool& pool)
+{
+    SetInfo(info);
+
+    m_tensor = pool.AllocateTensor(DataTypeToTF(m_info.dtype), GetShape());
+}
+
+Image::Image(ml_image_info const* info, void* data, size_t row_pitch, ml_image_deleter deleter)
+{
+    SetInfo(info);
+
+    if (data == nullptr)
+    {
+        throw std::runtime_error("Bad image data argument");
+    }
+
+    auto dtype = DataTypeToTF(m_info.dtype);
+    if (row_pitch != 0)
+    {
+        if (row_pitch < GetRowSize() || row_pitch % tensorflow::DataTypeSize(dtype) != 0)
+        {
+            throw std::runtime_error("Bad image row pitch " + std::to_string(row_pitch) + ", rows are "
+                                     + std::to_string(GetRowSize()) + " bytes");
+        }
+        m_row_pitch = row_pitch;
+    }
+
+    // The last row padding may lie outside the memory, e.g. for
+    // a sub-rectangle at the bottom of a frame
+    size_t size = (GetRowCount() - 1) * m_row_pitch + GetRowSize();
+    auto buffer = new ExternalBuffer(data, size, deleter);
+
+    if (IsContiguous())
+    {
+        m_tensor = tensorflow::Tensor(dtype, GetShape(), buffer);
+    }
+    else
+    {
+        m_tensor = tensorflow::Tensor(tensorflow::DT_UINT8,
+                                      { static_cast<tensorflow::int64>(size) }, buffer);
+    }
+
+    buffer->Unref();
+    m_is_external = true;
+}
+
+void Image::SetInfo(ml_image_info const* info)
 {
     if (info == nullptr)
     {
         throw std::runtime_error("Bad image information argument");
     }
 
-    size_t item_size = DataTypeSize(info->dtype);
-
     auto validate_dim = [info](auto dim, char const* name)
     {
         if (info->*dim != 0)
@@ -40,7 +141,10 @@ Image::Image(ml_image_info const* info)
     ForEachDim(validate_dim);
 
     m_info = *info;
-    m_data.resize(m_info.width * m_info.height * m_info.channels * item_size);
+    m_row_pitch = GetRowSize();
+
+    // Validates the layout
+    GetShape();
 }
 
 ml_status Image::GetInfo(ml_image_info* info) const
@@ -56,17 +160,19 @@ ml_status Image::GetInfo(ml_image_info* info) const
 
 void* Image::Map(size_t* size)
 {
+    tensorflow::StringPiece data = m_tensor.tensor_data();
+
     if (size != nullptr)
     {
-        *size = m_data.size();
+        *size = data.size();
     }
 
-    return m_data.data();
+    return const_cast<char*>(data.data());
 }
 
 ml_status Image::Unmap(void* data)
 {
-    if (data != m_data.data())
+    if (data != m_tensor.tensor_data().data())
     {
         return ML_FAIL;
     }
@@ -74,6 +180,75 @@ ml_status Image::Unmap(void* data)
     return ML_OK;
 }
 
+const tensorflow::Tensor& Image::GetTensor() const
+{
+    return m_tensor;
+}
+
+bool Image::SetTensor(const tensorflow::Tensor& tensor)
+{
+    if (tensor.dtype() != m_tensor.dtype() || !IsContiguous())
+    {
+        return false;
+    }
+
+    // External memory is kept, so the data is copied into it
+    if (m_is_external)
+    {
+        if (tensor.NumElements() != m_tensor.NumElements())
+        {
+            return false;
+        }
+
+        std::memcpy(const_cast<char*>(m_tensor.tensor_data().data()),
+                    tensor.tensor_data().data(), tensor.TotalBytes());
+        return true;
+    }
+
+    // Share the tensor buffer keeping the image shape
+    return m_tensor.CopyFrom(tensor, m_tensor.shape());
+}
+
+size_t Image::GetRowPitch() const
+{
+    return m_row_pitch;
+}
+
+size_t Image::GetRowSize() const
+{
+    size_t row_count = m_info.layout == ML_LAYOUT_CHW ? m_info.width : m_info.width * m_info.channels;
+    return row_count * tensorflow::DataTypeSize(DataTypeToTF(m_info.dtype));
+}
+
+size_t Image::GetRowCount() const
+{
+    return m_info.layout == ML_LAYOUT_CHW ? m_info.channels * m_info.height : m_info.height;
+}
+
+bool Image::IsContiguous() const
+{
+    return m_row_pitch == GetRowSize() || GetRowCount() == 1;
+}
+
+tensorflow::TensorShape Image::GetShape() const
+{
+    auto height = static_cast<tensorflow::int64>(m_info.height);
+    auto width = static_cast<tensorflow::int64>(m_info.width);
+    auto channels = static_cast<tensorflow::int64>(m_info.channels);
+
+    switch (m_info.layout)
+    {
+        case ML_LAYOUT_HWC:
+            return tensorflow::TensorShape { 1, height, width, channels };
+
+        case ML_LAYOUT_CHW:
+            return tensorflow::TensorShape { 1, channels, height, width };
+
+        default:
+            throw std::runtime_error("Unsupported image layout: " + std::to_string(m_info.layout));
+    }
+}
+
 } // namespace ML
 
 
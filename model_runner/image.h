@@ -1,8 +1,9 @@
 #pragma once
 
+#include "buffer_pool.h"
 #include "model_runner.h"
 
-#include <vector>
+#include "tensorflow/core/framework/tensor.h"
 
 
 namespace ML {
@@ -13,15 +14,39 @@ public:
     static ml_image MakeHandle(Image* image);
     static Image* FromHandle(ml_image image);
 
-    explicit Image(ml_image_info const* info);
+    // The image memory is taken from the pool
+    Image(ml_image_info const* info, BufferPool& pool);
+
+    // Wraps caller-owned memory, rows are `row_pitch` bytes apart,
+    // 0 for packed rows. The deleter is called when the memory is unused.
+    Image(ml_image_info const* info, void* data, size_t row_pitch, ml_image_deleter deleter);
 
     ml_status GetInfo(ml_image_info* info) const;
     void* Map(size_t* size);
     ml_status Unmap(void* data);
 
+    // The image data is kept in a tensor, so it can be fed to a session
+    // and replaced with a session output without copying. The tensor shape
+    // is (1, height, width, channels) or (1, channels, height, width)
+    // depending on the layout. Images with padded rows keep a byte tensor
+    // spanning all rows instead, it is accessed with the row pitch.
+    const tensorflow::Tensor& GetTensor() const;
+    bool SetTensor(const tensorflow::Tensor& tensor);
+
+    // Distance between image rows in bytes, plane rows for the CHW layout
+    size_t GetRowPitch() const;
+    size_t GetRowSize() const;
+    size_t GetRowCount() const;
+    bool IsContiguous() const;
+
 private:
+    void SetInfo(ml_image_info const* info);
+    tensorflow::TensorShape GetShape() const;
+
     ml_image_info m_info;
-    std::vector<char> m_data;
+    tensorflow::Tensor m_tensor;
+    size_t m_row_pitch;
+    bool m_is_external = false;
 };
 
 } // namespace ML
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+
+// Quotes and escapes a string for JSON output
+inline std::string JsonString(const std::string& value)
+{
+    std::ostringstream stream;
+    stream << '"';
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            stream << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+        }
+        else
+        {
+            stream << c;
+        }
+    }
+    stream << '"';
+    return stream.str();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <utility>
+
+
+namespace ML {
+
+/**
+ * Key-value map keeping a limited number of the most recently used items.
+ */
+template<class Key, class Value>
+class LruCache
+{
+public:
+    explicit LruCache(size_t capacity)
+        : m_capacity(capacity)
+    {
+    }
+
+    // Returns the value for a key and marks it as the most recently used,
+    // null if there is no such key
+    const Value* Find(const Key& key)
+    {
+        auto index = m_index.find(key);
+        if (index == m_index.end())
+        {
+            return nullptr;
+        }
+
+        m_items.splice(m_items.begin(), m_items, index->second);
+        return &index->second->second;
+    }
+
+    // Inserts or updates a value evicting the least recently used item
+    // if the cache is full
+    void Insert(const Key& key, Value value)
+    {
+        if (m_capacity == 0)
+        {
+            return;
+        }
+
+        auto index = m_index.find(key);
+        if (index != m_index.end())
+        {
+            index->second->second = std::move(value);
+            m_items.splice(m_items.begin(), m_items, index->second);
+            return;
+        }
+
+        if (m_items.size() == m_capacity)
+        {
+            m_index.erase(m_items.back().first);
+            m_items.pop_back();
+        }
+
+        m_items.emplace_front(key, std::move(value));
+        m_index.emplace(key, m_items.begin());
+    }
+
+private:
+    typedef std::list<std::pair<Key, Value>> ItemList;
+
+    size_t m_capacity;
+    ItemList m_items;
+    std::map<Key, typename ItemList::iterator> m_index;
+};
+
+} // namespace ML
@@ -1,10 +1,30 @@
 #include "model.h"
 
+#include "context.h"
+#include "convert.h"
 #include "dtype.h"
+#include "event.h"
+#include "graph_optimizer.h"
 #include "image.h"
+#include "tiling.h"
 #include "utils.h"
 
+#include "tensorflow/core/common_runtime/shape_refiner.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/platform/logging.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
 #include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
 
 
 #define PRINT_GRAPH_INFO 0
@@ -14,12 +34,343 @@ namespace tf = tensorflow;
 
 namespace {
 
-tf::SessionOptions CreateSessionOptions(const ml_model_params& params)
+constexpr size_t kDefaultInputInfoCacheSize = 8;
+
+void SetEnvironmentVariable(char const* name, char const* value)
+{
+    // Values set by the user take precedence
+    if (std::getenv(name) != nullptr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    _putenv_s(name, value);
+#else
+    setenv(name, value, 0);
+#endif
+}
+
+void SetWaitPolicy(ml_wait_policy policy)
+{
+    // OpenMP reads the settings once on initialization, so the first
+    // model created in a process determines the policy
+    switch (policy)
+    {
+        case ML_WAIT_POLICY_ACTIVE:
+            SetEnvironmentVariable("OMP_WAIT_POLICY", "ACTIVE");
+            SetEnvironmentVariable("KMP_BLOCKTIME", "infinite");
+            break;
+
+        case ML_WAIT_POLICY_PASSIVE:
+            SetEnvironmentVariable("OMP_WAIT_POLICY", "PASSIVE");
+            SetEnvironmentVariable("KMP_BLOCKTIME", "0");
+            break;
+
+        default:
+            break;
+    }
+}
+
+tf::SessionOptions CreateSessionOptions(const ml_model_params& params, const ML::Context& context)
 {
     tf::SessionOptions options;
+    auto& config = options.config;
+    auto& context_params = context.GetParams();
+
+    size_t intra_op_threads = params.intra_op_threads != 0 ?
+        params.intra_op_threads : context_params.intra_op_threads;
+
+    if (intra_op_threads != 0)
+    {
+        config.set_intra_op_parallelism_threads(static_cast<tf::int32>(intra_op_threads));
+    }
+
+    if (params.use_per_session_threads == 0)
+    {
+        // Models of a context share a single inter-op thread pool. Without
+        // a named pool, TensorFlow would use its process-wide pool sized by
+        // the first session, ignoring the counts of later models.
+        size_t inter_op_threads = params.inter_op_threads != 0 ?
+            params.inter_op_threads : context_params.inter_op_threads;
+
+        auto pool = config.add_session_inter_op_thread_pool();
+        pool->set_num_threads(static_cast<tf::int32>(inter_op_threads));
+        pool->set_global_name(ML::Context::GetThreadPoolName(inter_op_threads));
+    }
+    else if (params.inter_op_threads != 0)
+    {
+        config.set_inter_op_parallelism_threads(static_cast<tf::int32>(params.inter_op_threads));
+    }
+
+    config.set_use_per_session_threads(params.use_per_session_threads != 0);
+
+    if (params.optimizations & ML_OPTIMIZE_GRAPPLER)
+    {
+        auto rewrite_options = config.mutable_graph_options()->mutable_rewrite_options();
+        rewrite_options->set_constant_folding(tf::RewriterConfig::ON);
+        rewrite_options->set_arithmetic_optimization(tf::RewriterConfig::ON);
+        rewrite_options->set_dependency_optimization(tf::RewriterConfig::ON);
+        rewrite_options->set_remapping(tf::RewriterConfig::ON);
+        rewrite_options->set_layout_optimizer(tf::RewriterConfig::OFF); // NHWC is native on CPU
+        rewrite_options->set_min_graph_nodes(-1); // Optimize small graphs too
+    }
+
+    auto gpu_options = config.mutable_gpu_options();
+    if (params.gpu_memory_fraction > 0)
+    {
+        gpu_options->set_per_process_gpu_memory_fraction(params.gpu_memory_fraction);
+    }
+
+    if (params.visible_devices != nullptr)
+    {
+        gpu_options->set_visible_device_list(params.visible_devices);
+    }
+
+    if (params.use_memmapped_format != 0)
+    {
+        // Folding would copy the mapped constants into the heap
+        auto graph_options = config.mutable_graph_options();
+        graph_options->mutable_optimizer_options()->set_opt_level(tf::OptimizerOptions::L0);
+        graph_options->mutable_rewrite_options()->set_constant_folding(tf::RewriterConfig::OFF);
+    }
+
+    SetWaitPolicy(params.wait_policy);
+
     return options;
 }
 
+std::string GetModelKey(const ml_model_params& params, const tf::SessionOptions& options)
+{
+    std::string config;
+    options.config.SerializeToString(&config);
+
+    std::ostringstream key;
+    key << params.model_path << '\0';
+
+    if (params.input_node_count != 0)
+    {
+        key << params.input_node_count << '\0';
+        for (size_t i = 0; i < params.input_node_count; i++)
+        {
+            key << params.input_nodes[i] << '\0';
+        }
+    }
+    else
+    {
+        key << 1 << '\0' << (params.input_node != nullptr ? params.input_node : "") << '\0';
+    }
+
+    if (params.output_node_count != 0)
+    {
+        key << params.output_node_count << '\0';
+        for (size_t i = 0; i < params.output_node_count; i++)
+        {
+            key << params.output_nodes[i] << '\0';
+        }
+    }
+    else
+    {
+        key << 1 << '\0' << (params.output_node != nullptr ? params.output_node : "") << '\0';
+    }
+
+    key
+        << params.optimizations << '\0'
+        << params.precision << '\0'
+        << config;
+    return key.str();
+}
+
+// Copies a graph for shape inference without the values of large constants,
+// i.e. weights. Their dtype and shape attributes are kept, so the shapes are
+// still inferred, while small constants like shapes and sizes are evaluated.
+tf::GraphDef GetShapeGraph(const tf::GraphDef& graph_def)
+{
+    constexpr size_t kMaxShapeConstSize = 1024;
+
+    tf::GraphDef shape_graph_def;
+    *shape_graph_def.mutable_versions() = graph_def.versions();
+
+    for (auto& node : graph_def.node())
+    {
+        auto shape_node = shape_graph_def.add_node();
+        auto value = node.attr().find("value");
+
+        if (node.op() != "Const" || value == node.attr().end() ||
+            value->second.tensor().ByteSizeLong() <= kMaxShapeConstSize)
+        {
+            shape_node->CopyFrom(node);
+            continue;
+        }
+
+        // Copy all but the weight values
+        shape_node->set_name(node.name());
+        shape_node->set_op(node.op());
+        shape_node->set_device(node.device());
+        *shape_node->mutable_input() = node.input();
+
+        for (auto& attr : node.attr())
+        {
+            if (attr.first != "value")
+            {
+                (*shape_node->mutable_attr())[attr.first] = attr.second;
+            }
+        }
+
+        auto& tensor = value->second.tensor();
+        auto shape_tensor = (*shape_node->mutable_attr())["value"].mutable_tensor();
+        shape_tensor->set_dtype(tensor.dtype());
+        *shape_tensor->mutable_tensor_shape() = tensor.tensor_shape();
+    }
+
+    return shape_graph_def;
+}
+
+std::shared_ptr<ML::ModelData> LoadModelData(const ml_model_params& params,
+                                             const tf::SessionOptions& options)
+{
+    auto data = std::make_shared<ML::ModelData>();
+    std::ostringstream error;
+
+    tf::Env* env = tf::Env::Default();
+    std::string graph_path = params.model_path;
+
+    if (params.use_memmapped_format != 0)
+    {
+        // Weights are mapped read-only, so they are shared through
+        // the page cache and loaded on demand
+        data->env.reset(new tf::MemmappedEnv(env));
+
+        auto status = data->env->InitializeFromFile(params.model_path);
+        if (!status.ok())
+        {
+            error << "Error mapping model: " << params.model_path << ": " << status;
+            throw std::runtime_error(error.str());
+        }
+
+        env = data->env.get();
+        graph_path = tf::MemmappedFileSystem::kMemmappedPackageDefaultGraphDef;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto get_elapsed_time = [&start_time]()
+    {
+        auto time = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> elapsed_time = time - start_time;
+        start_time = time;
+        return elapsed_time.count();
+    };
+
+    auto status = tf::ReadBinaryProto(env, graph_path, &data->graph_def);
+    if (!status.ok())
+    {
+        error << "Error reading graph definition: " << params.model_path << ": " << status;
+        throw std::runtime_error(error.str());
+    }
+
+    data->read_time = get_elapsed_time();
+
+    auto& graph_def = data->graph_def;
+    if (graph_def.node_size() == 0)
+    {
+        error << "Empty graph: " << params.model_path;
+        throw std::runtime_error(error.str());
+    }
+
+    // The first and the last nodes are used if not specified
+    if (params.input_node_count != 0)
+    {
+        data->input_nodes.assign(params.input_nodes, params.input_nodes + params.input_node_count);
+    }
+    else
+    {
+        data->input_nodes.push_back(params.input_node != nullptr ?
+                                    params.input_node : graph_def.node(0).name());
+    }
+
+    if (params.output_node_count != 0)
+    {
+        data->output_nodes.assign(params.output_nodes, params.output_nodes + params.output_node_count);
+    }
+    else
+    {
+        data->output_nodes.push_back(params.output_node != nullptr ?
+                                     params.output_node : graph_def.node(graph_def.node_size() - 1).name());
+    }
+
+    data->original_node_count = graph_def.node_size();
+
+    unsigned optimizations = params.optimizations;
+    if (params.use_memmapped_format != 0)
+    {
+        optimizations &= ~(ML_OPTIMIZE_FOLD_CONSTANTS | ML_OPTIMIZE_FOLD_BATCH_NORMS);
+    }
+
+    status = ML::OptimizeGraph(data->input_nodes, data->output_nodes, optimizations, graph_def);
+    if (!status.ok())
+    {
+        error << "Error optimizing graph: " << status;
+        throw std::runtime_error(error.str());
+    }
+
+    status = ML::ConvertGraphPrecision(data->input_nodes, data->output_nodes,
+                                       params.precision, graph_def);
+    if (!status.ok())
+    {
+        error << "Error converting graph precision: " << status;
+        throw std::runtime_error(error.str());
+    }
+
+    data->node_count = graph_def.node_size();
+    data->shape_graph_def = GetShapeGraph(graph_def);
+    data->optimization_time = get_elapsed_time();
+
+    tf::SessionOptions session_options = options;
+    session_options.env = env;
+
+    tf::Session* session;
+    status = tf::NewSession(session_options, &session);
+    if (!status.ok())
+    {
+        error << "Unable to start session: " << status;
+        throw std::runtime_error(error.str());
+    }
+
+    data->session.reset(session);
+
+    status = session->Create(data->graph_def);
+    if (!status.ok())
+    {
+        error << "Error creating graph: " << status;
+        throw std::runtime_error(error.str());
+    }
+
+    data->session_time = get_elapsed_time();
+
+#if PRINT_GRAPH_INFO
+    std::cerr << "Model: " << params.model_path << "\n"
+              << "Nodes: " << data->original_node_count << " -> " << data->node_count << "\n"
+              << "Read: " << data->read_time << " ms, "
+              << "optimization: " << data->optimization_time << " ms, "
+              << "session creation: " << data->session_time << " ms\n";
+#endif
+
+    return data;
+}
+
+const tf::NodeDef& FindNode(const tf::GraphDef& graph_def, const std::string& name)
+{
+    for (auto& node : graph_def.node())
+    {
+        if (node.name() == name)
+        {
+            return node;
+        }
+    }
+
+    throw std::runtime_error("Node not found: " + name);
+}
+
 void FillImageInfo(const tf::NodeDef& node, ml_image_info& info)
 {
     auto dtype_iter = node.attr().find("dtype");
@@ -33,6 +384,7 @@ void FillImageInfo(const tf::NodeDef& node, ml_image_info& info)
     }
 
     info.dtype = ML::DataTypeFromTF(dtype_iter->second.type());
+    info.layout = ML_LAYOUT_HWC;
 
     auto& shape = node.attr().at("_output_shapes").list().shape(0);
     int dims = shape.dim_size();
@@ -47,6 +399,29 @@ void FillImageInfo(const tf::NodeDef& node, ml_image_info& info)
     info.channels = GetDim(-1);
 }
 
+size_t GetBatchSize(const tf::NodeDef& node)
+{
+    auto& shape = node.attr().at("_output_shapes").list().shape(0);
+    int dims = shape.dim_size();
+    if (dims < 4)
+    {
+        return 0;
+    }
+
+    auto value = shape.dim(dims - 4).size();
+    return value > 0 ? value : 0;
+}
+
+tf::TensorShape GetTensorShape(const ml_image_info& info)
+{
+    return {
+        1,
+        static_cast<tf::int64>(info.height),
+        static_cast<tf::int64>(info.width),
+        static_cast<tf::int64>(info.channels)
+    };
+}
+
 void FillImageInfo(const tf::Tensor& tensor, ml_image_info& info)
 {
     int dims = tensor.dims();
@@ -70,7 +445,9 @@ Model* Model::FromHandle(ml_model model)
     return reinterpret_cast<Model*>(model);
 }
 
-Model::Model(ml_model_params const* params)
+Model::Model(ml_model_params const* params, Context& context)
+    : m_output_info_cache(params != nullptr && params->input_info_cache_size != 0 ?
+                          params->input_info_cache_size : kDefaultInputInfoCacheSize)
 {
     if (params == nullptr)
     {
@@ -82,69 +459,95 @@ Model::Model(ml_model_params const* params)
         throw std::runtime_error("Bad model_path model parameter value");
     }
 
-    m_session.reset();
+    // Staging tensors share the image buffer pool and its page options
+    m_buffer_pool = context.GetBufferPool().shared_from_this();
 
-    auto status = tf::ReadBinaryProto(tf::Env::Default(), params->model_path, &m_graph_def);
-    if (!status.ok())
+    if (params->input_node_count != 0)
     {
-        m_error_cache << "Error reading graph definition: " << params->model_path << ": " << status;
-        throw std::runtime_error(m_error_cache.str());
+        if (params->input_nodes == nullptr ||
+            std::find(params->input_nodes, params->input_nodes + params->input_node_count,
+                      nullptr) != params->input_nodes + params->input_node_count)
+        {
+            throw std::runtime_error("Bad input_nodes model parameter value");
+        }
     }
 
-    int input_node_idx = 0;
-    int output_node_idx = m_graph_def.node_size() - 1;
-
-    for (int i = 0; i < m_graph_def.node_size(); i++)
+    if (params->output_node_count != 0)
     {
-        auto& node = m_graph_def.node(i);
-
-        if (params->input_node != nullptr && node.name() == params->input_node)
+        if (params->output_nodes == nullptr ||
+            std::find(params->output_nodes, params->output_nodes + params->output_node_count,
+                      nullptr) != params->output_nodes + params->output_node_count)
         {
-            input_node_idx = i;
-            FillImageInfo(node, m_input_info);
+            throw std::runtime_error("Bad output_nodes model parameter value");
         }
+    }
 
-        if (params->output_node != nullptr && node.name() == params->output_node)
-        {
-            output_node_idx = i;
-            FillImageInfo(node, m_output_info);
-        }
+    m_tracer = std::make_unique<Tracer>(*params);
+
+    m_tile_size = params->tile_size;
+    m_tile_halo = params->tile_halo;
+    m_tile_jobs = std::max<size_t>(params->tile_jobs, 1);
+
+    // The calling thread runs one of the jobs
+    for (size_t i = 1; i < m_tile_jobs; i++)
+    {
+        m_tile_executors.push_back(std::make_unique<Executor>());
     }
 
-    FillImageInfo(m_graph_def.node(input_node_idx), m_input_info);
-    FillImageInfo(m_graph_def.node(output_node_idx), m_output_info);
+    if (m_tile_size != 0 && m_tile_halo >= m_tile_size)
+    {
+        throw std::runtime_error("Bad tile_halo model parameter value");
+    }
 
-    m_input_node = m_graph_def.node(input_node_idx).name();
+    auto options = CreateSessionOptions(*params, context);
+    auto key = GetModelKey(*params, options);
 
-    m_output_nodes.clear();
-    m_output_nodes.push_back(m_graph_def.node(output_node_idx).name());
+    // Models created with the same parameters share the graph and the session
+    m_data = context.FindModelData(key);
+    if (m_data == nullptr)
+    {
+        m_data = context.AddModelData(key, LoadModelData(*params, options));
+    }
 
-    tf::Session* session;
-    status = tf::NewSession(CreateSessionOptions(*params), &session);
-    if (!status.ok())
+    m_input_nodes = m_data->input_nodes;
+    m_output_nodes = m_data->output_nodes;
+
+    for (auto& input_node : m_input_nodes)
     {
-        m_error_cache << "Unable to start session: " << status;
-        throw std::runtime_error(m_error_cache.str());
+        ml_image_info info;
+        FillImageInfo(FindNode(m_data->graph_def, input_node), info);
+        m_graph_input_infos.push_back(info);
     }
 
-    m_session.reset(session);
+    for (auto& output_node : m_output_nodes)
+    {
+        ml_image_info info;
+        FillImageInfo(FindNode(m_data->graph_def, output_node), info);
+        m_output_infos.push_back(info);
+    }
 
-    status = session->Create(m_graph_def);
-    if (!status.ok())
+    m_input_info = m_graph_input_infos.front();
+    m_model_input_infos = m_graph_input_infos;
+    m_model_output_infos = m_output_infos;
+
+    // A batch dimension fixed by the graph limits the batch size
+    m_max_batch_size = GetBatchSize(FindNode(m_data->graph_def, m_input_nodes.front()));
+    if (m_max_batch_size == 0 || (params->max_batch_size != 0 &&
+                                  params->max_batch_size < m_max_batch_size))
     {
-        m_session.reset();
-        m_error_cache << "Error creating graph: " << status;
-        throw std::runtime_error(m_error_cache.str());
+        m_max_batch_size = params->max_batch_size;
     }
 }
 
 ml_status Model::GetInfo(ml_image_info* input_info, ml_image_info* output_info)
 {
-    if (m_session == nullptr)
+    if (m_data == nullptr)
     {
         return ML_FAIL;
     }
 
+    std::shared_lock<std::shared_mutex> lock(m_info_mutex);
+
     if (input_info != nullptr)
     {
         *input_info = m_input_info;
@@ -152,7 +555,49 @@ ml_status Model::GetInfo(ml_image_info* input_info, ml_image_info* output_info)
 
     if (output_info != nullptr)
     {
-        *output_info = m_output_info;
+        *output_info = m_output_infos.front();
+    }
+
+    return ML_OK;
+}
+
+ml_status Model::GetOutputInfo(size_t index, ml_image_info* info)
+{
+    m_error_cache.str("");
+
+    std::shared_lock<std::shared_mutex> lock(m_info_mutex);
+
+    if (index >= m_output_nodes.size())
+    {
+        m_error_cache << "Bad output index " << index << ", the model has "
+                      << m_output_nodes.size() << " outputs";
+        return ML_FAIL;
+    }
+
+    if (info != nullptr)
+    {
+        *info = m_output_infos[index];
+    }
+
+    return ML_OK;
+}
+
+ml_status Model::GetInputInfo(size_t index, ml_image_info* info)
+{
+    m_error_cache.str("");
+
+    std::shared_lock<std::shared_mutex> lock(m_info_mutex);
+
+    if (index >= m_input_nodes.size())
+    {
+        m_error_cache << "Bad input index " << index << ", the model has "
+                      << m_input_nodes.size() << " inputs";
+        return ML_FAIL;
+    }
+
+    if (info != nullptr)
+    {
+        *info = GetInputImageInfo(index);
     }
 
     return ML_OK;
@@ -168,19 +613,36 @@ ml_status Model::SetInputInfo(ml_image_info const* info)
         return ML_FAIL;
     }
 
-    if (m_input_info.dtype != info->dtype)
+    // Wait for running inferences to finish
+    std::unique_lock<std::shared_mutex> lock(m_info_mutex);
+
+    // Input images are converted to the graph data type and layout
+    if (info->dtype != ML_FLOAT32 && info->dtype != ML_FLOAT16 && info->dtype != ML_UINT8)
+    {
+        m_error_cache << "Unsupported input data type " << info->dtype;
+        return ML_FAIL;
+    }
+
+    if (info->layout != ML_LAYOUT_HWC && info->layout != ML_LAYOUT_CHW)
     {
-        m_error_cache << "Overriding data type "
-                      << m_input_info.dtype << " with " << info->dtype;
+        m_error_cache << "Unsupported input layout " << info->layout;
         return ML_FAIL;
     }
 
-    auto validate_dim = [this, info](auto dim, char const* name)
+    // Only the dimensions unspecified by the graph may be changed,
+    // channels exceeding the graph ones are passed through
+    auto& graph_input_info = m_graph_input_infos.front();
+
+    auto validate_dim = [this, info, &graph_input_info](auto dim, char const* name)
     {
-        if (m_input_info.*dim != 0 && info->*dim != m_input_info.*dim)
+        bool is_extra_channels = dim == &ml_image_info::channels &&
+            info->*dim > graph_input_info.*dim;
+
+        if (graph_input_info.*dim != 0 && info->*dim != graph_input_info.*dim &&
+            !is_extra_channels)
         {
             m_error_cache << "Overriding " << name << " dimension "
-                          << m_input_info.*dim << " with " << info->*dim;
+                          << graph_input_info.*dim << " with " << info->*dim;
             return false;
         }
         return true;
@@ -191,6 +653,28 @@ ml_status Model::SetInputInfo(ml_image_info const* info)
         return ML_FAIL;
     }
 
+    // Other inputs have the same width and height, their channels
+    // are defined by the graph
+    for (size_t i = 1; i < m_graph_input_infos.size(); i++)
+    {
+        auto& other_info = m_graph_input_infos[i];
+
+        if ((other_info.width != 0 && other_info.width != info->width) ||
+            (other_info.height != 0 && other_info.height != info->height))
+        {
+            m_error_cache << "Input " << m_input_nodes[i] << " dimensions "
+                          << other_info.width << "x" << other_info.height << " do not match "
+                          << info->width << "x" << info->height;
+            return ML_FAIL;
+        }
+
+        if (other_info.channels == 0)
+        {
+            m_error_cache << "Input " << m_input_nodes[i] << " channel count is not specified";
+            return ML_FAIL;
+        }
+    }
+
     auto is_same_dim = [this, info](auto dim, char const* name)
     {
         return m_input_info.*dim == info->*dim;
@@ -198,33 +682,107 @@ ml_status Model::SetInputInfo(ml_image_info const* info)
 
     if (ForEachDim(is_same_dim))
     {
+        m_input_info.dtype = info->dtype;
+        m_input_info.layout = info->layout;
         return ML_OK; // Nothing's changed
     }
 
-    m_input_info = *info;
+    // The model keeps its previous info until the new one is known to work,
+    // so a failed call leaves input and output infos consistent
+    std::vector<ml_image_info> model_input_infos(m_model_input_infos.size());
+    std::vector<ml_image_info> model_output_infos = m_model_output_infos;
 
-    auto dtype = DataTypeToTF(m_input_info.dtype);
-
-    tf::TensorShape input_shape {
-        1,
-        static_cast<tf::int64>(m_input_info.height),
-        static_cast<tf::int64>(m_input_info.width),
-        static_cast<tf::int64>(m_input_info.channels)
+    auto commit_info = [&]()
+    {
+        m_input_info = *info;
+        m_model_input_infos = std::move(model_input_infos);
+        m_model_output_infos = std::move(model_output_infos);
+        UpdateOutputInfo();
     };
 
-    m_input_map.clear();
-    m_input_map.emplace_back(m_input_node, tf::Tensor(dtype, std::move(input_shape)));
+    for (size_t i = 0; i < model_input_infos.size(); i++)
+    {
+        auto& model_info = model_input_infos[i];
+        model_info = m_graph_input_infos[i];
+        model_info.width = info->width;
+        model_info.height = info->height;
+        if (model_info.channels == 0)
+        {
+            model_info.channels = info->channels;
+        }
+    }
+
+    InputDims input_dims(info->width, info->height, info->channels);
+
+    if (auto output_infos = m_output_info_cache.Find(input_dims))
+    {
+        model_output_infos = *output_infos;
+        commit_info();
+        return ML_OK;
+    }
 
     try
     {
-        // Run inference in order to know exact output image dimensions
-        Image input(info);
-        if (!InferToCache(input))
+        // A single tile is enough to know output dimensions
+        // in a case of tiled inference
+        std::vector<ml_image_info> probe_infos = model_input_infos;
+        bool is_tiled = IsTiled(*info);
+        if (is_tiled)
         {
-            return ML_FAIL;
+            for (auto& probe_info : probe_infos)
+            {
+                probe_info.width = std::min(probe_info.width, m_tile_size);
+                probe_info.height = std::min(probe_info.height, m_tile_size);
+            }
+        }
+
+        auto& probe_info = probe_infos.front();
+
+        if (!InferOutputInfo(probe_infos, model_output_infos))
+        {
+            // Run inference in order to know exact output image dimensions
+            std::vector<tf::Tensor> inputs;
+            for (auto& input_info : probe_infos)
+            {
+                inputs.emplace_back(DataTypeToTF(input_info.dtype), GetTensorShape(input_info));
+                auto input_data = inputs.back().tensor_data();
+                std::memset(const_cast<char*>(input_data.data()), 0, input_data.size());
+            }
+
+            // Probe runs are not traced, so traces show inferences only
+            std::vector<tf::Tensor> outputs;
+            if (!RunSession(inputs, m_output_nodes.size(), outputs, false))
+            {
+                return ML_FAIL;
+            }
+
+            for (size_t i = 0; i < outputs.size(); i++)
+            {
+                FillImageInfo(outputs[i], model_output_infos[i]);
+            }
+        }
+
+        if (is_tiled)
+        {
+            // Tiles are stitched assuming the outputs are the input upscaled
+            // by integer factors
+            for (auto& output_info : model_output_infos)
+            {
+                if (output_info.width % probe_info.width != 0 ||
+                    output_info.height % probe_info.height != 0)
+                {
+                    m_error_cache << "Tiled inference requires output dimensions "
+                                  << "to be multiples of input dimensions";
+                    return ML_FAIL;
+                }
+
+                output_info.width = output_info.width / probe_info.width * info->width;
+                output_info.height = output_info.height / probe_info.height * info->height;
+            }
         }
 
-        FillImageInfo(m_output_cache.front(), m_output_info);
+        m_output_info_cache.Insert(input_dims, model_output_infos);
+        commit_info();
         return ML_OK;
     }
     catch (std::exception& e)
@@ -235,78 +793,372 @@ ml_status Model::SetInputInfo(ml_image_info const* info)
 }
 
 ml_status Model::Infer(ml_image input, ml_image output)
+{
+    return InferMulti(&input, 1, &output, 1);
+}
+
+ml_status Model::InferMulti(ml_image const* inputs,
+                            size_t input_count,
+                            ml_image const* outputs,
+                            size_t output_count)
 {
     m_error_cache.str("");
 
-    if (ML::Image::FromHandle(input) == nullptr)
-    {
-        m_error_cache << "Bad input image handle";
-        return ML_FAIL;
-    }
+    StatsTimer total_timer(m_stats, ML_STATS_TOTAL);
 
-    if (ML::Image::FromHandle(output) == nullptr)
-    {
-        m_error_cache << "Bad output image handle";
-        return ML_FAIL;
-    }
+    std::shared_lock<std::shared_mutex> lock(m_info_mutex);
 
-    ml_image_info output_info;
-    ML::Image::FromHandle(output)->GetInfo(&output_info);
+    std::vector<const Image*> input_images;
+    std::vector<Image*> output_images;
 
-    auto validate_dim = [this, &output_info](auto dim, char const* name)
     {
-        if (output_info.*dim != m_output_info.*dim)
+        StatsTimer timer(m_stats, ML_STATS_VALIDATION);
+
+        if (inputs == nullptr || input_count == 0)
         {
-            m_error_cache << "Output image " << name << " dimension "
-                << output_info.*dim << " does not match " << m_output_info.*dim;
-            return false;
+            m_error_cache << "Bad input image array argument";
+            return ML_FAIL;
         }
-        return true;
-    };
 
-    if (!ForEachDim(validate_dim))
+        for (size_t i = 0; i < input_count; i++)
+        {
+            if (ML::Image::FromHandle(inputs[i]) == nullptr)
+            {
+                m_error_cache << "Bad input image handle at " << i;
+                return ML_FAIL;
+            }
+            input_images.push_back(ML::Image::FromHandle(inputs[i]));
+        }
+
+        if (!ValidateInputs(input_images))
+        {
+            return ML_FAIL;
+        }
+
+        // Only the requested outputs are computed
+        if (outputs == nullptr || output_count == 0 || output_count > m_output_nodes.size())
+        {
+            m_error_cache << "Bad output image array argument, the model has "
+                          << m_output_nodes.size() << " outputs";
+            return ML_FAIL;
+        }
+
+        for (size_t i = 0; i < output_count; i++)
+        {
+            if (ML::Image::FromHandle(outputs[i]) == nullptr)
+            {
+                m_error_cache << "Bad output image handle at " << i;
+                return ML_FAIL;
+            }
+
+            if (!ValidateOutput(*ML::Image::FromHandle(outputs[i]), m_output_infos[i]))
+            {
+                return ML_FAIL;
+            }
+
+            output_images.push_back(ML::Image::FromHandle(outputs[i]));
+        }
+    }
+
+    std::vector<tf::Tensor> input_tensors;
     {
-        return ML_FAIL;
+        StatsTimer timer(m_stats, ML_STATS_INPUT);
+
+        if (!GetInputTensors(input_images, input_tensors))
+        {
+            return ML_FAIL;
+        }
     }
 
-    if (!InferToCache(*ML::Image::FromHandle(input)))
+    std::vector<tf::Tensor> output_tensors;
     {
-        return ML_FAIL;
+        StatsTimer timer(m_stats, ML_STATS_SESSION);
+
+        // Tiles are stored into the output images as they are computed
+        if (IsTiled(m_input_info) ?
+            !InferTiled(input_tensors, output_images) :
+            !RunSession(input_tensors, output_count, output_tensors))
+        {
+            return ML_FAIL;
+        }
     }
 
-    size_t output_size;
-    void* output_data = ML::Image::FromHandle(output)->Map(&output_size);
+    StatsTimer timer(m_stats, ML_STATS_OUTPUT);
 
-    tf::StringPiece tensor_data = m_output_cache.front().tensor_data();
+    for (size_t i = 0; i < output_tensors.size(); i++)
+    {
+        if (!StoreOutput(output_tensors[i], input_tensors, *output_images[i], i))
+        {
+            return ML_FAIL;
+        }
+    }
 
-    if (output_size != tensor_data.size())
+    // Packed images have no channels to pass through
+    if (input_count != m_input_nodes.size())
     {
-        ML::Image::FromHandle(output)->Unmap(output_data);
+        return ML_OK;
+    }
 
-        m_error_cache << "Internal error: output size does not match: "
-            << output_size << " vs " << tensor_data.size();
-        return ML_FAIL;
+    for (size_t i = 0; i < output_count; i++)
+    {
+        if (!PassThroughChannels(*input_images.front(), *output_images[i], i))
+        {
+            return ML_FAIL;
+        }
     }
 
-    std::memcpy(output_data, tensor_data.data(), output_size);
-    ML::Image::FromHandle(output)->Unmap(output_data);
     return ML_OK;
 }
 
-char* Model::GetError(char* buffer, size_t buffer_size) const
+ml_event Model::InferAsync(ml_image input, ml_image output, ml_callback callback, void* user_data)
 {
-    return FillBuffer(buffer, buffer_size, m_error_cache.str());
+    m_error_cache.str("");
+
+    Event* event = nullptr;
+
+    try
+    {
+        event = new Event;
+
+        // The task keeps its own event reference
+        event->Retain();
+
+        m_executor.Submit([this, input, output, callback, user_data, event]()
+        {
+            // An exception escaping the executor thread would terminate
+            // the application, so it fails the inference instead
+            ml_status status = ML_FAIL;
+            try
+            {
+                status = Infer(input, output);
+            }
+            catch (std::exception& e)
+            {
+                m_error_cache << e.what();
+            }
+            catch (...)
+            {
+                m_error_cache << "Unknown inference error";
+            }
+
+            if (callback != nullptr)
+            {
+                callback(status, user_data);
+            }
+
+            // The error is stored for the executor thread
+            event->Complete(status, status == ML_OK ? std::string() : m_error_cache.str());
+            event->Release();
+        });
+
+        return Event::MakeHandle(event);
+    }
+    catch (std::exception& e)
+    {
+        if (event != nullptr)
+        {
+            event->Release();
+            event->Release();
+        }
+
+        m_error_cache << e.what();
+        return ML_INVALID_HANDLE;
+    }
 }
 
-bool Model::InferToCache(Image& input)
+ml_status Model::InferBatch(ml_image const* inputs, ml_image const* outputs, size_t count)
 {
-    m_output_cache.clear(); // Invalidate previous data
+    m_error_cache.str("");
+
+    std::shared_lock<std::shared_mutex> lock(m_info_mutex);
+
+    if (count == 0)
+    {
+        return ML_OK;
+    }
+
+    StatsTimer total_timer(m_stats, ML_STATS_TOTAL);
+
+    {
+        StatsTimer timer(m_stats, ML_STATS_VALIDATION);
+
+        if (inputs == nullptr || outputs == nullptr)
+        {
+            m_error_cache << "Bad image array argument";
+            return ML_FAIL;
+        }
+
+        if (m_input_nodes.size() != 1)
+        {
+            m_error_cache << "Batch inference is not supported for models with several inputs";
+            return ML_FAIL;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (ML::Image::FromHandle(inputs[i]) == nullptr)
+            {
+                m_error_cache << "Bad input image handle at " << i;
+                return ML_FAIL;
+            }
+
+            if (ML::Image::FromHandle(outputs[i]) == nullptr)
+            {
+                m_error_cache << "Bad output image handle at " << i;
+                return ML_FAIL;
+            }
+
+            if (!ValidateInput(*ML::Image::FromHandle(inputs[i]), m_input_info) ||
+                !ValidateOutput(*ML::Image::FromHandle(outputs[i]), m_output_infos.front()))
+            {
+                return ML_FAIL;
+            }
+        }
+    }
+
+    if (IsTiled(m_input_info))
+    {
+        // Each image is split into tiles on its own
+        for (size_t i = 0; i < count; i++)
+        {
+            auto& input = *ML::Image::FromHandle(inputs[i]);
+            auto& output = *ML::Image::FromHandle(outputs[i]);
+
+            std::vector<tf::Tensor> input_tensors(1);
+            {
+                StatsTimer timer(m_stats, ML_STATS_INPUT);
+
+                if (!GetInputTensor(input, m_model_input_infos.front(), input_tensors.front()))
+                {
+                    return ML_FAIL;
+                }
+            }
+
+            {
+                StatsTimer timer(m_stats, ML_STATS_SESSION);
+
+                if (!InferTiled(input_tensors, { &output }))
+                {
+                    return ML_FAIL;
+                }
+            }
+
+            StatsTimer timer(m_stats, ML_STATS_OUTPUT);
+
+            if (!PassThroughChannels(input, output, 0))
+            {
+                return ML_FAIL;
+            }
+        }
+        return ML_OK;
+    }
+
+    size_t max_batch_size = m_max_batch_size != 0 ? m_max_batch_size : count;
+
+    for (size_t first = 0; first < count; first += max_batch_size)
+    {
+        size_t batch_size = std::min(max_batch_size, count - first);
+
+        StatsTimer input_timer(m_stats, ML_STATS_INPUT);
+
+        // Stack the input images into a single tensor of the graph data type
+        auto& model_input_info = m_model_input_infos.front();
+        tf::Tensor batch = m_buffer_pool->AllocateTensor(DataTypeToTF(model_input_info.dtype), {
+            static_cast<tf::int64>(batch_size),
+            static_cast<tf::int64>(model_input_info.height),
+            static_cast<tf::int64>(model_input_info.width),
+            static_cast<tf::int64>(model_input_info.channels)
+        });
+
+        try
+        {
+            for (size_t i = 0; i < batch_size; i++)
+            {
+                auto& input = *ML::Image::FromHandle(inputs[first + i]);
+                tf::Tensor batch_slice = batch.Slice(i, i + 1);
+                ConvertImageToTensor(input, batch_slice);
+                m_stats.AddInputBytes(input.GetTensor().TotalBytes());
+            }
+        }
+        catch (std::exception& e)
+        {
+            m_error_cache << e.what();
+            return ML_FAIL;
+        }
+
+        input_timer.Stop();
 
+        std::vector<tf::Tensor> batch_outputs;
+        {
+            StatsTimer timer(m_stats, ML_STATS_SESSION);
+
+            if (!RunSession({ batch }, 1, batch_outputs))
+            {
+                return ML_FAIL;
+            }
+        }
+
+        StatsTimer output_timer(m_stats, ML_STATS_OUTPUT);
+
+        auto& output_tensor = batch_outputs.front();
+        if (output_tensor.dims() < 4 || static_cast<size_t>(output_tensor.dim_size(0)) != batch_size)
+        {
+            m_error_cache << "Internal error: unexpected batch output shape: "
+                          << output_tensor.shape().DebugString();
+            return ML_FAIL;
+        }
+
+        // Scatter the result across the output images
+        for (size_t i = 0; i < batch_size; i++)
+        {
+            if (!StoreOutput(output_tensor.Slice(i, i + 1), { batch },
+                             *ML::Image::FromHandle(outputs[first + i]), 0) ||
+                !PassThroughChannels(*ML::Image::FromHandle(inputs[first + i]),
+                                     *ML::Image::FromHandle(outputs[first + i]), 0))
+            {
+                return ML_FAIL;
+            }
+        }
+    }
+
+    return ML_OK;
+}
+
+ml_status Model::GetStats(ml_model_stats* stats)
+{
     m_error_cache.str("");
 
-    auto validate_dim = [this](auto dim, char const* name)
+    if (stats == nullptr)
     {
-        if (m_input_info.*dim == 0)
+        m_error_cache << "Bad stats argument";
+        return ML_FAIL;
+    }
+
+    m_stats.Get(stats);
+
+    stats->original_node_count = m_data->original_node_count;
+    stats->node_count = m_data->node_count;
+    stats->read_ms = m_data->read_time;
+    stats->optimization_ms = m_data->optimization_time;
+    stats->session_ms = m_data->session_time;
+    return ML_OK;
+}
+
+void Model::ResetStats()
+{
+    m_stats.Reset();
+}
+
+char* Model::GetError(char* buffer, size_t buffer_size) const
+{
+    return FillBuffer(buffer, buffer_size, m_error_cache.str());
+}
+
+bool Model::ValidateInput(const Image& input, const ml_image_info& info)
+{
+    auto validate_dim = [this, &info](auto dim, char const* name)
+    {
+        if (info.*dim == 0)
         {
             m_error_cache << "Input image " << name << " dimension is not specified";
             return false;
@@ -319,24 +1171,380 @@ bool Model::InferToCache(Image& input)
         return false;
     }
 
-    size_t input_size;
-    void* input_data = input.Map(&input_size);
+    ml_image_info input_info;
+    input.GetInfo(&input_info);
+
+    if (input_info.dtype != info.dtype)
+    {
+        m_error_cache << "Input image data type " << input_info.dtype
+                      << " does not match " << info.dtype;
+        return false;
+    }
+
+    if (input_info.layout != info.layout)
+    {
+        m_error_cache << "Input image layout " << input_info.layout
+                      << " does not match " << info.layout;
+        return false;
+    }
+
+    auto validate_input_dim = [this, &input_info, &info](auto dim, char const* name)
+    {
+        if (input_info.*dim != info.*dim)
+        {
+            m_error_cache << "Input image " << name << " dimension "
+                          << input_info.*dim << " does not match " << info.*dim;
+            return false;
+        }
+        return true;
+    };
+
+    return ForEachDim(validate_input_dim);
+}
+
+bool Model::ValidateOutput(const Image& output, const ml_image_info& info)
+{
+    ml_image_info output_info;
+    output.GetInfo(&output_info);
+
+    auto validate_dim = [this, &output_info, &info](auto dim, char const* name)
+    {
+        if (output_info.*dim != info.*dim)
+        {
+            m_error_cache << "Output image " << name << " dimension "
+                << output_info.*dim << " does not match " << info.*dim;
+            return false;
+        }
+        return true;
+    };
+
+    return ForEachDim(validate_dim);
+}
+
+bool Model::ValidateInputs(const std::vector<const Image*>& inputs)
+{
+    // Each image is fed to its own input node
+    if (inputs.size() == m_input_nodes.size())
+    {
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            if (!ValidateInput(*inputs[i], GetInputImageInfo(i)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    if (m_input_nodes.size() != 1)
+    {
+        m_error_cache << "The model expects " << m_input_nodes.size()
+                      << " input images, got " << inputs.size();
+        return false;
+    }
+
+    // Channels of several images are packed into a single input tensor
+    size_t model_channels = m_model_input_infos.front().channels;
+    size_t channels = 0;
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        ml_image_info input_info;
+        inputs[i]->GetInfo(&input_info);
+
+        ml_image_info expected_info = m_input_info;
+        expected_info.channels = input_info.channels;
+
+        if (!ValidateInput(*inputs[i], expected_info))
+        {
+            return false;
+        }
+
+        channels += input_info.channels;
+    }
+
+    if (channels != model_channels)
+    {
+        m_error_cache << "Input images have " << channels << " channels, "
+                      << model_channels << " expected";
+        return false;
+    }
+
+    return true;
+}
+
+bool Model::GetInputTensors(const std::vector<const Image*>& inputs,
+                            std::vector<tf::Tensor>& tensors)
+{
+    tensors.clear();
+
+    if (inputs.size() == m_input_nodes.size())
+    {
+        tensors.resize(inputs.size());
+
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            if (!GetInputTensor(*inputs[i], m_model_input_infos[i], tensors[i]))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // The images are validated to fill all the tensor channels
+    auto& model_info = m_model_input_infos.front();
+    tf::Tensor tensor = m_buffer_pool->AllocateTensor(DataTypeToTF(model_info.dtype),
+                                                      GetTensorShape(model_info));
+    size_t channel = 0;
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        ml_image_info input_info;
+        inputs[i]->GetInfo(&input_info);
+
+        try
+        {
+            ConvertImageToTensor(*inputs[i], tensor, channel);
+            m_stats.AddInputBytes(inputs[i]->GetTensor().TotalBytes());
+        }
+        catch (std::exception& e)
+        {
+            m_error_cache << e.what();
+            return false;
+        }
+
+        channel += input_info.channels;
+    }
+
+    tensors.push_back(tensor);
+    return true;
+}
+
+bool Model::InferTiled(const std::vector<tf::Tensor>& inputs, const std::vector<Image*>& outputs)
+{
+    // Outputs are accumulated separately, each may have its own scale
+    struct TiledOutput
+    {
+        size_t scale_x;
+        size_t scale_y;
+        TileAxis axis_x;
+        TileAxis axis_y;
+        ml_image_info info;
+        bool is_direct;
+        tf::Tensor tensor;
+    };
+
+    std::vector<TiledOutput> tiled_outputs;
+
+    for (size_t i = 0; i < outputs.size(); i++)
+    {
+        auto& model_info = m_model_output_infos[i];
+        size_t scale_x = model_info.width / m_input_info.width;
+        size_t scale_y = model_info.height / m_input_info.height;
+
+        ml_image_info output_info;
+        outputs[i]->GetInfo(&output_info);
+
+        // Tiles are accumulated in the output image if it has the model layout
+        // and aligned packed rows, otherwise in a float tensor converted into
+        // the image in the end
+        bool is_direct = output_info.layout == ML_LAYOUT_HWC &&
+            output_info.channels == model_info.channels &&
+            output_info.dtype != ML_UINT8 &&
+            outputs[i]->IsContiguous() && outputs[i]->GetTensor().IsAligned();
+
+        tf::Tensor tensor = is_direct ?
+            outputs[i]->GetTensor() : m_buffer_pool->AllocateTensor(tf::DT_FLOAT, GetTensorShape(model_info));
+
+        std::memset(const_cast<char*>(tensor.tensor_data().data()), 0, tensor.tensor_data().size());
+
+        tiled_outputs.push_back({
+            scale_x,
+            scale_y,
+            TileAxis(m_input_info.width, m_tile_size, m_tile_halo, scale_x),
+            TileAxis(m_input_info.height, m_tile_size, m_tile_halo, scale_y),
+            output_info,
+            is_direct,
+            tensor
+        });
+    }
+
+    // Tile placement in the input does not depend on the scale
+    auto& axis_x = tiled_outputs.front().axis_x;
+    auto& axis_y = tiled_outputs.front().axis_y;
+
+    std::vector<std::string> output_nodes(m_output_nodes.begin(),
+                                          m_output_nodes.begin() + outputs.size());
+
+    size_t tile_count = axis_x.GetTileCount() * axis_y.GetTileCount();
+    std::atomic<size_t> next_tile(0);
+    std::mutex output_mutex;
+    std::string error;
+
+    // Each job keeps a single tile and its activations alive at a time,
+    // so the peak memory depends on the tile size and the job count only
+    auto run_tiles = [&]()
+    {
+        try
+        {
+            std::vector<tf::Tensor> output_tiles;
+            std::vector<std::pair<std::string, tf::Tensor>> input_map;
+
+            for (size_t i = 0; i < inputs.size(); i++)
+            {
+                tf::Tensor input_tile(inputs[i].dtype(), {
+                    1,
+                    static_cast<tf::int64>(axis_y.GetTileSize()),
+                    static_cast<tf::int64>(axis_x.GetTileSize()),
+                    inputs[i].dim_size(3)
+                });
+
+                input_map.emplace_back(m_input_nodes[i], input_tile);
+            }
+
+            for (size_t tile = next_tile++; tile < tile_count; tile = next_tile++)
+            {
+                size_t tile_x = tile % axis_x.GetTileCount();
+                size_t tile_y = tile / axis_x.GetTileCount();
+
+                for (size_t i = 0; i < inputs.size(); i++)
+                {
+                    CopyTile(inputs[i], axis_x.GetTileOrigin(tile_x),
+                             axis_y.GetTileOrigin(tile_y), input_map[i].second);
+                }
+
+                auto status = RunGraph(input_map, output_nodes, output_tiles);
+
+                std::lock_guard<std::mutex> lock(output_mutex);
+
+                if (!status.ok())
+                {
+                    error = "Inference error: " + status.ToString();
+                    next_tile = tile_count;
+                    return;
+                }
+
+                for (size_t i = 0; i < tiled_outputs.size(); i++)
+                {
+                    auto& output = tiled_outputs[i];
+                    auto& output_tile = output_tiles[i];
+
+                    if (output_tile.dims() != 4 ||
+                        static_cast<size_t>(output_tile.dim_size(1)) != axis_y.GetTileSize() * output.scale_y ||
+                        static_cast<size_t>(output_tile.dim_size(2)) != axis_x.GetTileSize() * output.scale_x ||
+                        static_cast<size_t>(output_tile.dim_size(3)) != m_model_output_infos[i].channels)
+                    {
+                        error = "Internal error: unexpected tile output: " + output_tile.DebugString();
+                        next_tile = tile_count;
+                        return;
+                    }
+
+                    BlendTile(output_tile,
+                              output.axis_x.GetTileWeights(tile_x),
+                              output.axis_y.GetTileWeights(tile_y),
+                              output.axis_x.GetTileOrigin(tile_x) * output.scale_x,
+                              output.axis_y.GetTileOrigin(tile_y) * output.scale_y,
+                              output.tensor);
+                }
+            }
+        }
+        catch (std::exception& e)
+        {
+            std::lock_guard<std::mutex> lock(output_mutex);
+            error = e.what();
+            next_tile = tile_count;
+        }
+    };
+
+    // Additional jobs run on the workers of the model, which are started
+    // once rather than for every frame
+    size_t running_jobs = 0;
+    std::condition_variable jobs_finished;
 
-    tf::StringPiece tensor_data = m_input_map.front().second.tensor_data();
+    for (size_t i = 0; i + 1 < std::min(m_tile_jobs, tile_count); i++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(output_mutex);
+            running_jobs++;
+        }
+
+        try
+        {
+            m_tile_executors[i]->Submit([&]()
+            {
+                run_tiles();
+
+                std::lock_guard<std::mutex> lock(output_mutex);
+                if (--running_jobs == 0)
+                {
+                    jobs_finished.notify_all();
+                }
+            });
+        }
+        catch (std::exception&)
+        {
+            std::lock_guard<std::mutex> lock(output_mutex);
+            running_jobs--;
+            break; // Continue with the jobs already started
+        }
+    }
+
+    run_tiles();
 
-    if (input_size != tensor_data.size())
     {
-        input.Unmap(input_data);
+        std::unique_lock<std::mutex> lock(output_mutex);
+        jobs_finished.wait(lock, [&running_jobs] { return running_jobs == 0; });
+    }
 
-        m_error_cache << "Internal error: input size does not match: "
-                      << input_size << " vs " << tensor_data.size();
+    if (!error.empty())
+    {
+        m_error_cache << error;
         return false;
     }
 
-    std::memcpy(const_cast<char*>(tensor_data.data()), input_data, input_size);
-    input.Unmap(input_data);
+    for (size_t i = 0; i < tiled_outputs.size(); i++)
+    {
+        auto& output = tiled_outputs[i];
+        if (output.is_direct)
+        {
+            continue;
+        }
+
+        try
+        {
+            ConvertTensorToImage(output.tensor, *outputs[i]);
+            m_stats.AddOutputBytes(output.tensor.TotalBytes());
+        }
+        catch (std::exception& e)
+        {
+            m_error_cache << e.what();
+            return false;
+        }
+    }
+
+    return true;
+}
 
-    auto status = m_session->Run(m_input_map, m_output_nodes, {}, &m_output_cache);
+bool Model::RunSession(const std::vector<tf::Tensor>& inputs,
+                       size_t output_count,
+                       std::vector<tf::Tensor>& outputs,
+                       bool is_traced)
+{
+    outputs.clear(); // Invalidate previous data
+
+    std::vector<std::pair<std::string, tf::Tensor>> input_map;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        input_map.emplace_back(m_input_nodes[i], inputs[i]);
+    }
+
+    std::vector<std::string> output_nodes(m_output_nodes.begin(),
+                                          m_output_nodes.begin() + output_count);
+
+    auto status = RunGraph(input_map, output_nodes, outputs, is_traced);
     if (!status.ok())
     {
         m_error_cache << "Inference error: " << status;
@@ -346,6 +1554,223 @@ bool Model::InferToCache(Image& input)
     return true;
 }
 
+tf::Status Model::RunGraph(const std::vector<std::pair<std::string, tf::Tensor>>& inputs,
+                           const std::vector<std::string>& output_nodes,
+                           std::vector<tf::Tensor>& outputs,
+                           bool is_traced)
+{
+    size_t trace_index;
+    if (!is_traced || !m_tracer->StartTrace(trace_index))
+    {
+        return m_data->session->Run(inputs, output_nodes, {}, &outputs);
+    }
+
+    // Full tracing records the start and end time of each op
+    tf::RunOptions run_options;
+    run_options.set_trace_level(tf::RunOptions::FULL_TRACE);
+    tf::RunMetadata run_metadata;
+
+    auto status = m_data->session->Run(run_options, inputs, output_nodes, {}, &outputs, &run_metadata);
+
+    // Diagnostics do not fail inferences, the outputs are still returned
+    std::string error;
+    if (status.ok() && !m_tracer->WriteTrace(trace_index, run_metadata, error))
+    {
+        LOG(WARNING) << error;
+    }
+    return status;
+}
+
+bool Model::IsTiled(const ml_image_info& input_info) const
+{
+    return m_tile_size != 0 &&
+        (input_info.width > m_tile_size || input_info.height > m_tile_size);
+}
+
+bool Model::InferOutputInfo(const std::vector<ml_image_info>& input_infos,
+                            std::vector<ml_image_info>& output_infos) const
+{
+    // Propagate the input shapes through the graph without running it,
+    // the weights are not copied
+    tf::GraphDef graph_def = m_data->shape_graph_def;
+
+    for (auto& node : *graph_def.mutable_node())
+    {
+        auto input_node = std::find(m_input_nodes.begin(), m_input_nodes.end(), node.name());
+        if (input_node != m_input_nodes.end())
+        {
+            auto& info = input_infos[input_node - m_input_nodes.begin()];
+            GetTensorShape(info).AsProto((*node.mutable_attr())["shape"].mutable_shape());
+        }
+    }
+
+    tf::Graph graph(tf::OpRegistry::Global());
+    tf::ShapeRefiner refiner(graph_def.versions().producer(), graph.op_registry());
+
+    auto status = tf::ImportGraphDef(tf::ImportGraphDefOptions(), graph_def, &graph, &refiner);
+    if (!status.ok())
+    {
+        return false;
+    }
+
+    std::unordered_map<std::string, tf::Node*> nodes;
+    for (tf::Node* node : graph.nodes())
+    {
+        nodes[node->name()] = node;
+    }
+
+    for (size_t i = 0; i < m_output_nodes.size(); i++)
+    {
+        auto node = nodes.find(m_output_nodes[i]);
+        if (node == nodes.end())
+        {
+            return false;
+        }
+
+        auto context = refiner.GetContext(node->second);
+        if (context == nullptr || context->num_outputs() == 0)
+        {
+            return false;
+        }
+
+        auto shape = context->output(0);
+        if (!context->FullyDefined(shape) || context->Rank(shape) < 3)
+        {
+            return false; // Shape depends on data or unknown ops
+        }
+
+        int dims = context->Rank(shape);
+        output_infos[i].height = context->Value(context->Dim(shape, dims - 3));
+        output_infos[i].width = context->Value(context->Dim(shape, dims - 2));
+        output_infos[i].channels = context->Value(context->Dim(shape, dims - 1));
+    }
+
+    return true;
+}
+
+bool Model::GetInputTensor(const Image& input, const ml_image_info& model_info, tf::Tensor& tensor)
+{
+    auto shape = GetTensorShape(model_info);
+    auto dtype = DataTypeToTF(model_info.dtype);
+
+    // The image tensor is fed directly if possible, no data is copied.
+    // Kernels require aligned tensors, so caller-owned memory may be staged.
+    if (IsTensorLayout(input, dtype, model_info.channels) && input.GetTensor().IsAligned())
+    {
+        if (!tensor.CopyFrom(input.GetTensor(), shape))
+        {
+            m_error_cache << "Internal error: input tensor does not match: "
+                          << input.GetTensor().DebugString();
+            return false;
+        }
+        return true;
+    }
+
+    try
+    {
+        tensor = m_buffer_pool->AllocateTensor(dtype, shape);
+        ConvertImageToTensor(input, tensor);
+        m_stats.AddInputBytes(input.GetTensor().TotalBytes());
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        m_error_cache << e.what();
+        return false;
+    }
+}
+
+bool Model::StoreOutput(const tf::Tensor& tensor,
+                        const std::vector<tf::Tensor>& inputs,
+                        Image& output,
+                        size_t index)
+{
+    auto is_input_buffer = [&tensor](const tf::Tensor& input)
+    {
+        return tensor.SharesBufferWith(input);
+    };
+
+    // The output image takes over the output tensor buffer unless the buffer
+    // is forwarded from an input, e.g. by an identity graph, it is
+    // a misaligned part of a batch or the image format differs
+    if (IsTensorLayout(output, tensor.dtype(), m_model_output_infos[index].channels) &&
+        std::none_of(inputs.begin(), inputs.end(), is_input_buffer) && tensor.IsAligned())
+    {
+        if (!output.SetTensor(tensor))
+        {
+            m_error_cache << "Internal error: output tensor does not match: "
+                          << tensor.DebugString();
+            return false;
+        }
+
+        // Caller-owned memory receives a copy
+        if (!output.GetTensor().SharesBufferWith(tensor))
+        {
+            m_stats.AddOutputBytes(tensor.TotalBytes());
+        }
+        return true;
+    }
+
+    try
+    {
+        ConvertTensorToImage(tensor, output);
+        m_stats.AddOutputBytes(tensor.TotalBytes());
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        m_error_cache << "Error storing output: " << e.what();
+        return false;
+    }
+}
+
+bool Model::PassThroughChannels(const Image& input, Image& output, size_t index)
+{
+    size_t count = m_output_infos[index].channels - m_model_output_infos[index].channels;
+    if (count == 0)
+    {
+        return true;
+    }
+
+    try
+    {
+        CopyImageChannels(input, m_model_input_infos.front().channels,
+                          output, m_model_output_infos[index].channels, count);
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        m_error_cache << "Error passing channels through: " << e.what();
+        return false;
+    }
+}
+
+void Model::UpdateOutputInfo()
+{
+    m_output_infos = m_model_output_infos;
+
+    // Extra input channels, e.g. alpha, are appended to the outputs
+    // whose pixels match the input
+    for (auto& output_info : m_output_infos)
+    {
+        if (output_info.width == m_input_info.width && output_info.height == m_input_info.height)
+        {
+            output_info.channels += m_input_info.channels - m_model_input_infos.front().channels;
+        }
+    }
+}
+
+ml_image_info Model::GetInputImageInfo(size_t index) const
+{
+    // Images of all inputs have the same format, except for the channels
+    ml_image_info info = m_input_info;
+    if (index != 0)
+    {
+        info.channels = m_model_input_infos[index].channels;
+    }
+    return info;
+}
+
 } // namespace ML
 
 
@@ -379,6 +1804,26 @@ ml_status mlSetModelInputInfo(ml_model model, ml_image_info const* info)
     return ML::Model::FromHandle(model)->SetInputInfo(info);
 }
 
+ml_status mlGetModelInputInfo(ml_model model, size_t index, ml_image_info* info)
+{
+    if (ML::Model::FromHandle(model) == nullptr)
+    {
+        return ML_FAIL;
+    }
+
+    return ML::Model::FromHandle(model)->GetInputInfo(index, info);
+}
+
+ml_status mlGetModelOutputInfo(ml_model model, size_t index, ml_image_info* info)
+{
+    if (ML::Model::FromHandle(model) == nullptr)
+    {
+        return ML_FAIL;
+    }
+
+    return ML::Model::FromHandle(model)->GetOutputInfo(index, info);
+}
+
 ml_status mlInfer(ml_model model, ml_image inputs, ml_image outputs)
 {
     if (ML::Model::FromHandle(model) == nullptr)
@@ -389,6 +1834,64 @@ ml_status mlInfer(ml_model model, ml_image inputs, ml_image outputs)
     return ML::Model::FromHandle(model)->Infer(inputs, outputs);
 }
 
+ml_status mlInferMulti(ml_model model,
+                       ml_image const* inputs,
+                       size_t input_count,
+                       ml_image const* outputs,
+                       size_t output_count)
+{
+    if (ML::Model::FromHandle(model) == nullptr)
+    {
+        return ML_FAIL;
+    }
+
+    return ML::Model::FromHandle(model)->InferMulti(inputs, input_count, outputs, output_count);
+}
+
+ml_status mlInferBatch(ml_model model, ml_image const* inputs, ml_image const* outputs, size_t count)
+{
+    if (ML::Model::FromHandle(model) == nullptr)
+    {
+        return ML_FAIL;
+    }
+
+    return ML::Model::FromHandle(model)->InferBatch(inputs, outputs, count);
+}
+
+ml_event mlInferAsync(ml_model model,
+                      ml_image input,
+                      ml_image output,
+                      ml_callback callback,
+                      void* user_data)
+{
+    if (ML::Model::FromHandle(model) == nullptr)
+    {
+        return ML_INVALID_HANDLE;
+    }
+
+    return ML::Model::FromHandle(model)->InferAsync(input, output, callback, user_data);
+}
+
+ml_status mlGetModelStats(ml_model model, ml_model_stats* stats)
+{
+    if (ML::Model::FromHandle(model) == nullptr)
+    {
+        return ML_FAIL;
+    }
+
+    return ML::Model::FromHandle(model)->GetStats(stats);
+}
+
+void mlResetModelStats(ml_model model)
+{
+    if (ML::Model::FromHandle(model) == nullptr)
+    {
+        return;
+    }
+
+    ML::Model::FromHandle(model)->ResetStats();
+}
+
 void mlReleaseModel(ml_model model)
 {
     delete ML::Model::FromHandle(model);
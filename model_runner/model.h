@@ -2,43 +2,129 @@
 
 #include "model_runner.h"
 
+#include "buffer_pool.h"
+#include "executor.h"
+#include "lru_cache.h"
+#include "stats.h"
+#include "trace.h"
+#include "utils.h"
+
 #include "tensorflow/core/public/session.h"
+#include "tensorflow/core/util/memmapped_file_system.h"
 
 #include <memory>
-#include <sstream>
+#include <shared_mutex>
 #include <string>
+#include <tuple>
 #include <vector>
 
 
 namespace ML {
 
+class Context;
 class Image;
 
+/**
+ * Loaded model graph and the session running it. Shared by models created
+ * with the same parameters, since sessions may be run concurrently.
+ */
+struct ModelData
+{
+    std::unique_ptr<tensorflow::MemmappedEnv> env; // Must outlive the session
+    tensorflow::GraphDef graph_def;
+    tensorflow::GraphDef shape_graph_def; // Without weights, for shape inference
+    std::vector<std::string> input_nodes;
+    std::vector<std::string> output_nodes;
+    std::unique_ptr<tensorflow::Session> session;
+
+    // Loading statistics
+    int original_node_count = 0;
+    int node_count = 0;
+    double read_time = 0;         // Milliseconds
+    double optimization_time = 0; // Milliseconds
+    double session_time = 0;      // Milliseconds
+};
+
 class Model
 {
 public:
     static ml_model MakeHandle(Model* model);
     static Model* FromHandle(ml_model model);
 
-    explicit Model(ml_model_params const* params);
+    Model(ml_model_params const* params, Context& context);
 
     ml_status GetInfo(ml_image_info* input_info, ml_image_info* output_info);
+    ml_status GetInputInfo(size_t index, ml_image_info* info);
     ml_status SetInputInfo(ml_image_info const* info);
     ml_status Infer(ml_image input, ml_image output);
+    ml_status GetOutputInfo(size_t index, ml_image_info* info);
+    ml_status InferMulti(ml_image const* inputs,
+                         size_t input_count,
+                         ml_image const* outputs,
+                         size_t output_count);
+    ml_status InferBatch(ml_image const* inputs, ml_image const* outputs, size_t count);
+    ml_event InferAsync(ml_image input, ml_image output, ml_callback callback, void* user_data);
+    ml_status GetStats(ml_model_stats* stats);
+    void ResetStats();
     char* GetError(char* buffer, size_t buffer_size) const;
 
 private:
-    bool InferToCache(Image& input);
+    bool ValidateInput(const Image& input, const ml_image_info& info);
+    bool ValidateOutput(const Image& output, const ml_image_info& info);
+    bool ValidateInputs(const std::vector<const Image*>& inputs);
+    bool GetInputTensors(const std::vector<const Image*>& inputs,
+                         std::vector<tensorflow::Tensor>& tensors);
+    bool GetInputTensor(const Image& input, const ml_image_info& model_info, tensorflow::Tensor& tensor);
+    bool InferTiled(const std::vector<tensorflow::Tensor>& inputs, const std::vector<Image*>& outputs);
+    bool RunSession(const std::vector<tensorflow::Tensor>& inputs,
+                    size_t output_count,
+                    std::vector<tensorflow::Tensor>& outputs,
+                    bool is_traced = true);
+    tensorflow::Status RunGraph(const std::vector<std::pair<std::string, tensorflow::Tensor>>& inputs,
+                                const std::vector<std::string>& output_nodes,
+                                std::vector<tensorflow::Tensor>& outputs,
+                                bool is_traced = true);
+    bool IsTiled(const ml_image_info& input_info) const;
+    bool InferOutputInfo(const std::vector<ml_image_info>& input_infos,
+                         std::vector<ml_image_info>& output_infos) const;
+    bool StoreOutput(const tensorflow::Tensor& tensor,
+                     const std::vector<tensorflow::Tensor>& inputs,
+                     Image& output,
+                     size_t index);
+    bool PassThroughChannels(const Image& input, Image& output, size_t index);
+    void UpdateOutputInfo();
+    ml_image_info GetInputImageInfo(size_t index) const;
 
-    std::string m_input_node;
-    tensorflow::GraphDef m_graph_def;
-    ml_image_info m_input_info;
-    ml_image_info m_output_info;
-    std::vector<std::pair<std::string, tensorflow::Tensor>> m_input_map;
+    std::vector<std::string> m_input_nodes;
     std::vector<std::string> m_output_nodes;
-    std::unique_ptr<tensorflow::Session> m_session;
-    std::vector<tensorflow::Tensor> m_output_cache;
-    std::ostringstream m_error_cache;
+    std::shared_ptr<const ModelData> m_data;
+    std::vector<ml_image_info> m_graph_input_infos;
+    ml_image_info m_input_info;  // Input image format
+    std::vector<ml_image_info> m_output_infos; // Output image formats, including passed through channels
+
+    // Tensor formats of the graph input and output for the current input
+    std::vector<ml_image_info> m_model_input_infos;
+    std::vector<ml_image_info> m_model_output_infos;
+
+    // Model output information for recently used input dimensions
+    typedef std::tuple<size_t, size_t, size_t> InputDims;
+    LruCache<InputDims, std::vector<ml_image_info>> m_output_info_cache;
+    size_t m_max_batch_size;
+    size_t m_tile_size;
+    size_t m_tile_halo;
+    size_t m_tile_jobs;
+    std::shared_ptr<BufferPool> m_buffer_pool;
+    std::unique_ptr<Tracer> m_tracer;
+    mutable std::shared_mutex m_info_mutex;
+    ThreadErrorCache m_error_cache;
+    ModelStats m_stats;
+
+    // Tiled inference workers, their threads are started by the first
+    // tiled inference
+    std::vector<std::unique_ptr<Executor>> m_tile_executors;
+
+    // Destroyed first, so the queued inferences finish with the model intact
+    Executor m_executor;
 };
 
 } // namespace ML
@@ -0,0 +1,244 @@
+#include "arg_parser.h"
+
+#include "tensorflow/cc/framework/scope.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/shape_refiner.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/platform/env.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace tf = tensorflow;
+namespace ops = tensorflow::ops;
+
+struct GeneratorParams
+{
+    int channels;
+    int output_channels;
+    int depth;
+    int width;
+    int convs;
+    unsigned seed;
+};
+
+class UNetBuilder
+{
+public:
+    explicit UNetBuilder(const GeneratorParams& params)
+        : m_params(params)
+        , m_random(params.seed)
+    {
+    }
+
+    tf::Output Build(const tf::Scope& scope, tf::Output input)
+    {
+        auto x = input;
+        int input_features = m_params.channels;
+        std::vector<std::pair<tf::Output, int>> skips;
+
+        for (int level = 0; level < m_params.depth; level++)
+        {
+            auto level_scope = scope.NewSubScope("encoder_" + std::to_string(level));
+            x = ConvBlock(level_scope, x, input_features, m_params.width << level);
+            input_features = m_params.width << level;
+
+            skips.emplace_back(x, input_features);
+            x = ops::MaxPool(level_scope.WithOpName("pool"), x, { 1, 2, 2, 1 }, { 1, 2, 2, 1 }, "VALID");
+        }
+
+        auto bottleneck_scope = scope.NewSubScope("bottleneck");
+        x = ConvBlock(bottleneck_scope, x, input_features, m_params.width << m_params.depth);
+        input_features = m_params.width << m_params.depth;
+
+        for (int level = m_params.depth - 1; level >= 0; level--)
+        {
+            auto level_scope = scope.NewSubScope("decoder_" + std::to_string(level));
+            auto& skip = skips[level];
+
+            // Upsampled to the skip size, so odd image sizes are handled
+            auto skip_size = ops::StridedSlice(level_scope.WithOpName("skip_size"),
+                                               ops::Shape(level_scope, skip.first), { 1 }, { 3 }, { 1 });
+            x = ops::ResizeNearestNeighbor(level_scope.WithOpName("upsample"), x, skip_size);
+            x = ops::Concat(level_scope.WithOpName("concat"), { x, skip.first }, 3);
+
+            x = ConvBlock(level_scope, x, input_features + skip.second, m_params.width << level);
+            input_features = m_params.width << level;
+        }
+
+        return Conv(scope.NewSubScope("output_conv"), x, input_features, m_params.output_channels, 1);
+    }
+
+private:
+    tf::Output ConvBlock(const tf::Scope& scope, tf::Output x, int input_features, int features)
+    {
+        for (int i = 0; i < m_params.convs; i++)
+        {
+            auto conv_scope = scope.NewSubScope("conv_" + std::to_string(i));
+            x = ops::Relu(conv_scope.WithOpName("relu"),
+                          Conv(conv_scope, x, i == 0 ? input_features : features, features, 3));
+        }
+        return x;
+    }
+
+    tf::Output Conv(const tf::Scope& scope, tf::Output x, int input_features, int features, int size)
+    {
+        // He initialization keeps activations in a similar range at any depth
+        tf::Tensor filter(tf::DT_FLOAT, { size, size, input_features, features });
+        std::uniform_real_distribution<float> distribution(-1, 1);
+        float limit = std::sqrt(6.f / (size * size * input_features));
+
+        auto filter_data = filter.flat<float>();
+        for (tf::int64 i = 0; i < filter_data.size(); i++)
+        {
+            filter_data(i) = limit * distribution(m_random);
+        }
+
+        tf::Tensor bias(tf::DT_FLOAT, { features });
+        auto bias_data = bias.flat<float>();
+        for (tf::int64 i = 0; i < bias_data.size(); i++)
+        {
+            bias_data(i) = 0.01f * distribution(m_random);
+        }
+
+        auto conv = ops::Conv2D(scope.WithOpName("conv"), x,
+                                ops::Const(scope.WithOpName("filter"), filter),
+                                { 1, 1, 1, 1 }, "SAME");
+        return ops::BiasAdd(scope.WithOpName("bias_add"), conv,
+                            ops::Const(scope.WithOpName("bias"), bias));
+    }
+
+    GeneratorParams m_params;
+    std::mt19937 m_random;
+};
+
+// The model runner reads node shapes from _output_shapes attributes,
+// as added by TensorFlow when a graph is exported with add_shapes
+void AddOutputShapes(tf::GraphDef& graph_def)
+{
+    tf::Graph graph(tf::OpRegistry::Global());
+    tf::ShapeRefiner refiner(graph_def.versions().producer(), graph.op_registry());
+
+    auto status = tf::ImportGraphDef(tf::ImportGraphDefOptions(), graph_def, &graph, &refiner);
+    if (!status.ok())
+    {
+        throw std::runtime_error("Shape inference error: " + status.ToString());
+    }
+
+    std::unordered_map<std::string, tf::Node*> nodes;
+    for (tf::Node* node : graph.nodes())
+    {
+        nodes[node->name()] = node;
+    }
+
+    for (auto& node_def : *graph_def.mutable_node())
+    {
+        auto context = refiner.GetContext(nodes.at(node_def.name()));
+        auto& output_shapes = *(*node_def.mutable_attr())["_output_shapes"].mutable_list();
+
+        for (int i = 0; i < context->num_outputs(); i++)
+        {
+            auto shape = context->output(i);
+            auto& shape_proto = *output_shapes.add_shape();
+
+            if (!context->RankKnown(shape))
+            {
+                shape_proto.set_unknown_rank(true);
+                continue;
+            }
+
+            for (int dim = 0; dim < context->Rank(shape); dim++)
+            {
+                auto dim_handle = context->Dim(shape, dim);
+                shape_proto.add_dim()->set_size(
+                    tf::shape_inference::InferenceContext::ValueKnown(dim_handle) ?
+                    context->Value(dim_handle) : -1);
+            }
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+try
+{
+    ArgParser parser;
+    GeneratorParams params;
+
+    std::string output_path;
+    parser.AddArg(&output_path, "o", "Path to the generated model (protobuf format)");
+
+    params.channels = 3;
+    parser.AddArg(&params.channels, "c", "Input image channels, 3 if omitted", true);
+
+    params.output_channels = 0;
+    parser.AddArg(&params.output_channels, "oc",
+                  "Output image channels, same as input if omitted", true);
+
+    params.depth = 3;
+    parser.AddArg(&params.depth, "d",
+                  "Number of UNet levels, each halves the resolution, 3 if omitted,"
+                  " 0 for a plain convolution stack", true);
+
+    params.width = 16;
+    parser.AddArg(&params.width, "w",
+                  "Features of the first level, doubled by each next level, 16 if omitted", true);
+
+    params.convs = 2;
+    parser.AddArg(&params.convs, "convs", "3x3 convolutions per level, 2 if omitted", true);
+
+    params.seed = 1;
+    parser.AddArg(&params.seed, "seed", "Random seed of the weights, 1 if omitted", true);
+
+    parser.Parse(argc, argv);
+
+    if (params.output_channels == 0)
+    {
+        params.output_channels = params.channels;
+    }
+
+    if (params.channels <= 0 || params.output_channels <= 0 || params.depth < 0 ||
+        params.width <= 0 || params.convs <= 0)
+    {
+        throw std::runtime_error("Channel, level, feature and convolution counts must be positive");
+    }
+
+    // Input and output node names follow the denoiser models
+    auto root = tf::Scope::NewRootScope();
+    auto input = ops::Placeholder(root.WithOpName("input"), tf::DT_FLOAT,
+                                  ops::Placeholder::Shape({ -1, -1, -1, params.channels }));
+
+    UNetBuilder builder(params);
+    ops::Identity(root.WithOpName("output"), builder.Build(root.NewSubScope("unet"), input));
+
+    tf::GraphDef graph_def;
+    auto status = root.ToGraphDef(&graph_def);
+    if (!status.ok())
+    {
+        throw std::runtime_error("Graph building error: " + status.ToString());
+    }
+
+    AddOutputShapes(graph_def);
+
+    std::cerr << "Writing " << output_path << ", " << graph_def.node_size() << " nodes\n";
+
+    status = tf::WriteBinaryProto(tf::Env::Default(), output_path, graph_def);
+    if (!status.ok())
+    {
+        throw std::runtime_error("Error writing model: " + status.ToString());
+    }
+}
+catch (std::exception& e)
+{
+    std::cerr << e.what() << std::endl;
+    return -1;
+}
@@ -22,6 +22,12 @@
  * -# Release the images using mlReleaseImage().
  * -# Release the model using mlReleaseModel().
  * -# Release the context using mlReleaseContext().
+ *
+ * A model handle may be used for inference from several threads at once,
+ * e.g. mlInfer() calls with different images are run concurrently.
+ * Error messages are kept per thread, so mlGetModelError() and
+ * mlGetContextError() return the error of the last operation
+ * made by the calling thread.
  */
 
 #include <stddef.h>
@@ -47,16 +53,347 @@ extern "C" {
 #endif
 
 
+/**
+ * Behavior of idle inference threads.
+ */
+enum ml_wait_policy
+{
+    ML_WAIT_POLICY_DEFAULT, /**< Library default. */
+    ML_WAIT_POLICY_ACTIVE,  /**< Spin waiting for work, lower latency. */
+    ML_WAIT_POLICY_PASSIVE  /**< Sleep waiting for work, cores are yielded. */
+};
+
+/**
+ * Model graph optimizations applied on loading, may be combined.
+ */
+enum ml_graph_optimization
+{
+    ML_OPTIMIZE_PRUNE = 1,            /**< Remove nodes not needed to compute the output. */
+    ML_OPTIMIZE_STRIP_IDENTITY = 2,   /**< Remove Identity and CheckNumerics nodes. */
+    ML_OPTIMIZE_FOLD_CONSTANTS = 4,   /**< Precompute constant subgraphs. */
+    ML_OPTIMIZE_FOLD_BATCH_NORMS = 8, /**< Merge batch normalization into convolution weights. */
+    ML_OPTIMIZE_GRAPPLER = 16,        /**<
+                                       * Enable constant folding, arithmetic
+                                       * simplification and operation fusion
+                                       * by the TensorFlow runtime optimizer.
+                                       */
+    ML_OPTIMIZE_ALL = 31
+};
+
+/**
+ * Precision of model computations.
+ */
+enum ml_precision
+{
+    ML_PRECISION_DEFAULT, /**< As stored in the model. */
+    ML_PRECISION_FLOAT16, /**< Single precision operations are computed in half precision. */
+    ML_PRECISION_MIXED    /**<
+                           * Convolutions, activations and other operations
+                           * tolerant to precision loss are computed in half
+                           * precision, the rest are kept in single precision.
+                           */
+};
+
 /**
  * Model parameters. All unused values must be initialized to 0.
  */
 struct ml_model_params
 {
-    char const* model_path; /**< Path to a model in protobuf format. */
+    char const* model_path; /**<
+                             * Path to a model in protobuf format,
+                             * or in memmapped format if use_memmapped_format
+                             * is set.
+                             */
 
     char const* input_node; /**< Input graph node name, autodetect if null. */
 
     char const* output_node; /**< Output graph node name, autodetect if null. */
+
+    unsigned optimizations; /**<
+                             * Combination of #ml_graph_optimization flags.
+                             * Folding is not applied to memmapped models,
+                             * since it would copy the mapped weights.
+                             */
+
+    ml_precision precision; /**<
+                             * Computation precision, model input and output
+                             * data types are not affected. The model_precision_check
+                             * tool compares results to the original precision.
+                             */
+
+    int use_memmapped_format; /**<
+                               * Non-zero if the model is converted to memmapped
+                               * format with the model_converter tool. The model
+                               * weights are mapped into memory instead of being
+                               * read, so they are loaded on demand and shared
+                               * between processes.
+                               */
+
+    size_t max_batch_size; /**<
+                            * Maximum number of images stacked into a single
+                            * inference run by mlInferBatch(). Limited by
+                            * the batch dimension of the model if it is fixed.
+                            * Unlimited if 0.
+                            */
+
+    size_t tile_size; /**<
+                       * Maximum tile width and height, in pixels.
+                       * Larger images are split into tiles inferred
+                       * separately, so the memory used for inference
+                       * does not depend on the image size.
+                       * Images are not split if 0.
+                       */
+
+    size_t tile_halo; /**<
+                       * Minimum number of pixels shared by neighbouring
+                       * tiles. The results are blended across the shared
+                       * area to hide the seams. Must be less than tile_size.
+                       */
+
+    size_t tile_jobs; /**<
+                       * Number of tiles inferred in parallel, 1 if 0.
+                       * The model keeps tile_jobs - 1 worker threads,
+                       * started by the first tiled inference.
+                       */
+
+    size_t intra_op_threads; /**<
+                              * Number of threads used to parallelize
+                              * a single operation. If 0, the context setting
+                              * is used. The thread pool is shared by all models
+                              * in a process unless use_per_session_threads
+                              * is set, so the first model determines its size.
+                              */
+
+    size_t inter_op_threads; /**<
+                              * Number of threads running independent
+                              * operations concurrently. If 0, the thread pool
+                              * of the context is used. Otherwise the model
+                              * uses a pool of this size, shared with the models
+                              * and contexts in a process using the same size,
+                              * so unlike intra_op_threads it takes effect for
+                              * every model. Cores are only partitioned between
+                              * the model and other work with
+                              * use_per_session_threads, which also applies
+                              * intra_op_threads to this model alone.
+                              * @see ml_context_params::inter_op_threads.
+                              */
+
+    int use_per_session_threads; /**<
+                                  * Non-zero to create thread pools used by
+                                  * this model only, instead of the pools
+                                  * shared within a process.
+                                  */
+
+    size_t input_info_cache_size; /**<
+                                   * Number of recently used input dimension
+                                   * sets, for which mlSetModelInputInfo()
+                                   * does not need to examine the model again.
+                                   * 8 if 0.
+                                   */
+
+    ml_wait_policy wait_policy; /**<
+                                 * Idle thread behavior of OpenMP-based kernels
+                                 * (MKL builds). Applied process-wide unless the
+                                 * OMP_WAIT_POLICY and KMP_BLOCKTIME environment
+                                 * variables are set, only the first model
+                                 * created in a process takes effect.
+                                 */
+
+    float gpu_memory_fraction; /**<
+                                * Fraction of GPU memory allowed to use
+                                * by versions with GPU support, (0..1].
+                                * All memory is used by default.
+                                */
+
+    char const* visible_devices; /**<
+                                  * Comma-delimited list of GPU devices
+                                  * accessible for calculations.
+                                  * All devices are visible by default.
+                                  */
+
+    char const* trace_path; /**<
+                             * Path prefix of op execution traces. Traced
+                             * session runs are written as Chrome trace
+                             * timelines, <prefix>.<pid>.<model>.<n>.json,
+                             * viewable in chrome://tracing or Perfetto, and
+                             * summaries of the slowest ops,
+                             * <prefix>.<pid>.<model>.<n>.txt, where <model>
+                             * numbers the models created in the process.
+                             * A failed trace write is logged as a TensorFlow
+                             * warning, the inference is not affected. Runs
+                             * done by mlSetModelInputInfo() are not traced.
+                             * The ML_TRACE_PATH environment variable is used
+                             * if null, runs are not traced if both are unset.
+                             */
+
+    size_t trace_interval; /**<
+                            * Every trace_interval-th session run is traced,
+                            * starting from the first one. Tiled inferences
+                            * run the session for each tile. The
+                            * ML_TRACE_INTERVAL environment variable is used
+                            * if 0, each run is traced if both are unset.
+                            */
+
+    size_t trace_count; /**<
+                         * Maximum number of traced runs. The ML_TRACE_COUNT
+                         * environment variable is used if 0, 1 if both
+                         * are unset.
+                         */
+
+    size_t trace_top_ops; /**< Number of ops listed in trace summaries, 20 if 0. */
+
+    char const* const* input_nodes; /**<
+                                     * Input graph node names for models with
+                                     * several inputs, e.g. color, albedo and
+                                     * normal images. Overrides input_node if
+                                     * input_node_count is not 0.
+                                     */
+
+    size_t input_node_count; /**< Number of input_nodes elements. */
+
+    char const* const* output_nodes; /**<
+                                      * Output graph node names for models with
+                                      * several outputs, e.g. a denoised image
+                                      * and a confidence map, computed by one
+                                      * session run. Overrides output_node if
+                                      * output_node_count is not 0.
+                                      */
+
+    size_t output_node_count; /**< Number of output_nodes elements. */
+};
+
+/**
+ * Huge page backing of large image and tensor buffers.
+ */
+enum ml_huge_pages
+{
+    ML_HUGE_PAGES_NONE,        /**< Regular pages. */
+    ML_HUGE_PAGES_TRANSPARENT, /**< Transparent huge pages, if enabled by the system. */
+    ML_HUGE_PAGES_EXPLICIT     /**<
+                                * Pages reserved in the system huge page pool,
+                                * transparent ones if the pool is exhausted.
+                                */
+};
+
+/**
+ * Context parameters. All unused values must be initialized to 0.
+ */
+struct ml_context_params
+{
+    size_t intra_op_threads; /**<
+                              * Number of threads used to parallelize a single
+                              * operation, for models not specifying their own
+                              * count. All cores are used if 0.
+                              */
+
+    size_t inter_op_threads; /**<
+                              * Size of the thread pool running independent
+                              * operations, shared by all models created with
+                              * the context unless they specify their own
+                              * thread configuration. All cores are used if 0.
+                              */
+
+    size_t image_pool_size; /**<
+                             * Maximum total size of released image buffers
+                             * kept for reuse by new images, in bytes. The least
+                             * recently released buffers are freed first.
+                             * If 0, the default cap is used: 4 times the largest
+                             * buffer requested, at least 64 MiB.
+                             * See also mlTrimImagePool().
+                             */
+
+    ml_huge_pages huge_pages; /**<
+                               * Huge page backing of image buffers and
+                               * intermediate tensors of 2 MiB and larger,
+                               * reducing TLB misses on large frames.
+                               * Output tensors allocated by TensorFlow, which
+                               * output images may take over after mlInfer(),
+                               * are not covered.
+                               * Supported on Linux.
+                               */
+
+    unsigned long long numa_node_mask; /**<
+                                        * Bit mask of NUMA nodes to place image
+                                        * buffers and intermediate tensors of
+                                        * 2 MiB and larger on, e.g. the node
+                                        * whose cores run the inference threads.
+                                        * Several nodes are interleaved. Memory
+                                        * is placed on the node of the thread
+                                        * touching it first if 0. Output
+                                        * tensors allocated by TensorFlow are
+                                        * not covered, as for huge_pages.
+                                        * Image creation fails if the memory
+                                        * policy cannot be set.
+                                        * Supported on Linux.
+                                        */
+};
+
+/**
+ * Image buffer pool statistics, see mlGetImagePoolStats().
+ */
+struct ml_image_pool_stats
+{
+    size_t allocated_bytes;  /**< Size of the buffers used by images and tensors, in bytes. */
+    size_t pooled_bytes;     /**< Size of the released buffers kept for reuse, in bytes. */
+    size_t allocation_count; /**< Number of image and tensor buffers requested. */
+    size_t hit_count;        /**< Number of requests served by released buffers. */
+};
+
+/**
+ * Inference phases timed by model statistics, see mlGetModelStats().
+ */
+enum ml_stats_phase
+{
+    ML_STATS_VALIDATION, /**< Argument and image validation. */
+    ML_STATS_INPUT,      /**< Conversion and copying of input images into tensors. */
+    ML_STATS_SESSION,    /**< Session runs, including tile copying in tiled mode. */
+    ML_STATS_OUTPUT,     /**< Conversion and copying of results into output images. */
+    ML_STATS_TOTAL,      /**< Whole inference calls. */
+    ML_STATS_PHASE_COUNT
+};
+
+/**
+ * Number of latency histogram buckets. The first bucket counts times under
+ * 64 microseconds, each next one times up to twice longer, the last one
+ * counts all longer times.
+ */
+#define ML_STATS_HISTOGRAM_SIZE 16
+
+/**
+ * Timings of an inference phase.
+ */
+struct ml_phase_stats
+{
+    size_t count;    /**< Number of times the phase was run. */
+    double total_ms; /**< Total time, in milliseconds. */
+    double min_ms;   /**< Minimum time, in milliseconds. */
+    double max_ms;   /**< Maximum time, in milliseconds. */
+    size_t histogram[ML_STATS_HISTOGRAM_SIZE]; /**< Time histogram. */
+};
+
+/**
+ * Model performance statistics, see mlGetModelStats().
+ */
+struct ml_model_stats
+{
+    ml_phase_stats phases[ML_STATS_PHASE_COUNT]; /**< Timings indexed by #ml_stats_phase. */
+
+    size_t input_bytes;  /**<
+                          * Size of input images copied or converted into
+                          * tensors, images fed as is are not counted.
+                          */
+
+    size_t output_bytes; /**<
+                          * Size of results copied or converted into output
+                          * images, outputs taking over result tensors are
+                          * not counted.
+                          */
+
+    size_t original_node_count; /**< Graph node count before optimizations. */
+    size_t node_count;          /**< Graph node count of the loaded model. */
+    double read_ms;             /**< Model file reading time, in milliseconds. */
+    double optimization_ms;     /**< Graph optimization time, in milliseconds. */
+    double session_ms;          /**< Session creation time, in milliseconds. */
 };
 
 /**
@@ -74,6 +411,11 @@ typedef struct ml_model_t* ml_model;
  */
 typedef struct ml_image_t* ml_image;
 
+/**
+ * Event handle, signalled when an asynchronous operation is complete.
+ */
+typedef struct ml_event_t* ml_event;
+
 #define ML_INVALID_HANDLE NULL
 
 /**
@@ -85,6 +427,31 @@ enum ml_status
     ML_FAIL
 };
 
+/**
+ * Asynchronous operation state.
+ */
+enum ml_event_status
+{
+    ML_EVENT_PENDING,  /**< The operation is queued or running. */
+    ML_EVENT_COMPLETE, /**< The operation has succeeded. */
+    ML_EVENT_FAILED    /**< The operation has failed. */
+};
+
+/**
+ * Asynchronous operation completion callback.
+ *
+ * @param[in] status    The operation status.
+ * @param[in] user_data The user data pointer passed along with the callback.
+ */
+typedef void (*ml_callback)(ml_status status, void* user_data);
+
+/**
+ * Releases caller-owned image memory, see mlCreateImageFromMemory().
+ *
+ * @param[in] data The image data pointer passed to mlCreateImageFromMemory().
+ */
+typedef void (*ml_image_deleter)(void* data);
+
 /**
  * Image underlying data type.
  */
@@ -92,6 +459,16 @@ enum ml_data_type
 {
     ML_FLOAT32,
     ML_FLOAT16,
+    ML_UINT8,   /**< Normalized, values 0..255 are mapped to 0..1 for float models. */
+};
+
+/**
+ * Image memory layout.
+ */
+enum ml_image_layout
+{
+    ML_LAYOUT_HWC, /**< Interleaved channels, (height, width, channels). */
+    ML_LAYOUT_CHW  /**< Planar channels, (channels, height, width). */
 };
 
 /**
@@ -99,10 +476,11 @@ enum ml_data_type
  */
 struct ml_image_info
 {
-    ml_data_type dtype; /**< Underlying data type. */
-    size_t width;       /**< Image width. in pixels. 0 if unspecified. */
-    size_t height;      /**< Image height, in pixels. 0 if unspecified. */
-    size_t channels;    /**< Image channel count. 0 if unspecified. */
+    ml_data_type dtype;     /**< Underlying data type. */
+    size_t width;           /**< Image width. in pixels. 0 if unspecified. */
+    size_t height;          /**< Image height, in pixels. 0 if unspecified. */
+    size_t channels;        /**< Image channel count. 0 if unspecified. */
+    ml_image_layout layout; /**< Memory layout, interleaved if 0. */
 };
 
 
@@ -114,6 +492,17 @@ struct ml_image_info
  */
 ML_API_ENTRY ml_context mlCreateContext();
 
+/**
+ * Creates a context with given parameters.
+ *
+ * @param[in] params Context parameters, defaults are used if null.
+ *                   @see #ml_context_params.
+ *
+ * @return A valid context handle in case of success, ML_INVALID_HANDLE
+ *         otherwise. The context should be released with mlReleaseContext().
+ */
+ML_API_ENTRY ml_context mlCreateContextWithParams(ml_context_params const* params);
+
 /**
  * Returns a formatted message with the last operation error.
  * May be called in case an operation returns ML_FAIL or ML_INVALID_HANDLE.
@@ -126,6 +515,28 @@ ML_API_ENTRY ml_context mlCreateContext();
  */
 ML_API_ENTRY char* mlGetContextError(ml_context context, char* buffer, size_t buffer_size);
 
+/**
+ * Returns statistics of the context image buffer pool.
+ * Images created with mlCreateImage() and intermediate tensors converting
+ * images get 64-byte aligned buffers from the pool, released images return them. Buffers are grouped in size
+ * classes, so images of the same size reuse memory without allocating it.
+ *
+ * @param[in]  context A valid context handle.
+ * @param[out] stats   A pointer to the result statistics structure.
+ *
+ * @return ML_OK in case of success, ML_FAIL otherwise.
+ */
+ML_API_ENTRY ml_status mlGetImagePoolStats(ml_context context, ml_image_pool_stats* stats);
+
+/**
+ * Frees the released image buffers kept by the context for reuse,
+ * e.g. after the image size is changed. Buffers of existing images are
+ * not affected.
+ *
+ * @param[in] context A valid context handle.
+ */
+ML_API_ENTRY void mlTrimImagePool(ml_context context);
+
 /**
  * Releases a context created with mlCreateContext(), invalidates the handle.
  *
@@ -136,7 +547,9 @@ ML_API_ENTRY void mlReleaseContext(ml_context context);
 
 /**
  * Creates a 3D image with a given description.
- * Image dimension order is (height, width, channels).
+ * Image dimension order is (height, width, channels) or (channels, height,
+ * width), depending on the layout. The image memory is 64-byte aligned and
+ * is not initialized, it is taken from the context image buffer pool.
  *
  * @param[in] context A valid context handle.
  * @param[in] info    Image description with all dimensions specified.
@@ -147,6 +560,36 @@ ML_API_ENTRY void mlReleaseContext(ml_context context);
  */
 ML_API_ENTRY ml_image mlCreateImage(ml_context context, ml_image_info const* info);
 
+/**
+ * Creates a 3D image using caller-owned memory, e.g. a renderer framebuffer
+ * or a sub-rectangle of a larger frame, so no copy into the image is needed.
+ * Rows may be padded: for the HWC layout each image row starts row_pitch bytes
+ * after the previous one, for the CHW layout each plane row does.
+ * Images with packed rows and memory aligned to 64 bytes are fed to the model
+ * as is, others are staged through a temporary buffer. Inference results are
+ * written into the memory, mlMapImage() returns the data pointer.
+ *
+ * @param[in] context   A valid context handle.
+ * @param[in] info      Image description with all dimensions specified.
+ * @param[in] data      A pointer to the first image row.
+ * @param[in] row_pitch The distance between rows in bytes, a multiple of the
+ *                      data type size, 0 for packed rows.
+ * @param[in] deleter   A function called with the data pointer when the
+ *                      memory is no longer used, may be null if the caller
+ *                      keeps the memory until the image is released and
+ *                      the inferences using it are done. The deleter is
+ *                      not called if the image creation fails.
+ *
+ * @return A valid image handle in case of success, ML_INVALID_HANDLE
+ *         otherwise. The image should be released with mlReleaseImage().
+ *         To get more details in case of failure, call mlGetContextError().
+ */
+ML_API_ENTRY ml_image mlCreateImageFromMemory(ml_context context,
+                                              ml_image_info const* info,
+                                              void* data,
+                                              size_t row_pitch,
+                                              ml_image_deleter deleter);
+
 /**
  * Returns image description.
  *
@@ -180,7 +623,8 @@ ML_API_ENTRY void* mlMapImage(ml_image image, size_t* size);
 ML_API_ENTRY ml_status mlUnmapImage(ml_image image, void* data);
 
 /**
- * Releases an image created with mlCreateImage(), invalidates the handle.
+ * Releases an image created with mlCreateImage() or mlCreateImageFromMemory(),
+ * invalidates the handle.
  *
  * @param[in] image A valid image handle.
  */
@@ -189,6 +633,9 @@ ML_API_ENTRY void mlReleaseImage(ml_image image);
 
 /**
  * Loads model data from a file.
+ * Models created by a context with the same model path, node names and
+ * thread configuration share the loaded graph and weights, only the first
+ * such model actually loads the file.
  *
  * @param[in] model  A valid context handle.
  * @param[in] params Model parameters. @see #ml_model_params.
@@ -230,16 +677,61 @@ ML_API_ENTRY ml_status mlGetModelInfo(ml_model model,
 
 /**
  * Updates input image information. All image dimensions must be specified.
- * @note This is a heavy operation, so avoid using it frequently.
+ * Output image dimensions are derived from the model graph. If that is not
+ * possible, an inference is run to find them out, so the call may be heavy.
+ * @note Waits for the inferences running in other threads to finish.
  *
  * @param[in] model A valid model handle.
  * @param[in] info  Input image information. The specified dimensions must
- *                  match the dimensions already known by the model.
+ *                  match the dimensions fixed by the model graph. The data
+ *                  type and the layout may differ from the model ones, input
+ *                  images are converted then. Channels exceeding the model
+ *                  channel count, e.g. alpha, are passed through to the output
+ *                  image if the output has the same width and height, and
+ *                  are ignored otherwise.
  */
 ML_API_ENTRY ml_status mlSetModelInputInfo(ml_model model, ml_image_info const* info);
 
+/**
+ * Returns information of an input image of a model with several input nodes.
+ * All input images have the width, height, data type and layout set with
+ * mlSetModelInputInfo(), channel counts of the inputs except for the first
+ * one are defined by the model graph.
+ *
+ * @param[in]  model A valid model handle.
+ * @param[in]  index The input index, see ml_model_params::input_nodes.
+ * @param[out] info  A pointer to the result info structure.
+ *
+ * @return ML_OK in case of success, ML_FAIL otherwise.
+ *         To get more details in case of failure, call mlGetModelError().
+ */
+ML_API_ENTRY ml_status mlGetModelInputInfo(ml_model model, size_t index, ml_image_info* info);
+
+/**
+ * Returns information of an output image of a model with several output nodes.
+ * All output images have the data type and layout of the model, mlGetModelInfo()
+ * returns the first output information.
+ *
+ * @param[in]  model A valid model handle.
+ * @param[in]  index The output index, see ml_model_params::output_nodes.
+ * @param[out] info  A pointer to the result info structure.
+ *
+ * @return ML_OK in case of success, ML_FAIL otherwise.
+ *         To get more details in case of failure, call mlGetModelError().
+ */
+ML_API_ENTRY ml_status mlGetModelOutputInfo(ml_model model, size_t index, ml_image_info* info);
+
 /**
  * Gets an input image and fills an output image.
+ * @note No image data is copied: the input image memory is passed to the model
+ *       as is, and the output image takes over the memory holding the result.
+ *       Thus the output image data must be mapped after the inference is done,
+ *       previously mapped pointers become invalid.
+ *       The data is converted if the image data types or layouts differ from
+ *       the model ones, the output image may have any supported data type
+ *       and layout.
+ *       Images created with mlCreateImageFromMemory() keep their memory,
+ *       the result is written into it.
  *
  * @param[in] model  A valid model handle.
  * @param[in] input  A valid input image descriptor.
@@ -250,14 +742,148 @@ ML_API_ENTRY ml_status mlSetModelInputInfo(ml_model model, ml_image_info const*
  */
 ML_API_ENTRY ml_status mlInfer(ml_model model, ml_image input, ml_image output);
 
+/**
+ * Gets several input images and fills several output images.
+ * If the image count equals the number of model input nodes, each image
+ * is fed to its own node. If the model has a single input node, channels
+ * of the images are packed into it in order, e.g. 3 color, 3 albedo and
+ * 3 normal channels make a 9-channel input, without a host-side copy.
+ * The outputs are computed by a single session run, so the graph part they
+ * share is evaluated once. Only the first output_count model outputs are
+ * computed, mlInfer() computes the first one.
+ *
+ * @param[in] model        A valid model handle.
+ * @param[in] inputs       An array of valid input image descriptors.
+ * @param[in] input_count  The number of elements in the inputs array.
+ * @param[in] outputs      An array of valid output image descriptors,
+ *                         in the ml_model_params::output_nodes order.
+ * @param[in] output_count The number of elements in the outputs array,
+ *                         from 1 to the number of model output nodes.
+ *
+ * @return ML_OK in case of success, ML_FAIL otherwise.
+ *         To get more details in case of failure, call mlGetModelError().
+ */
+ML_API_ENTRY ml_status mlInferMulti(ml_model model,
+                                    ml_image const* inputs,
+                                    size_t input_count,
+                                    ml_image const* outputs,
+                                    size_t output_count);
+
+/**
+ * Runs inference for several images of the same size at once.
+ * The input images are stacked along the batch dimension, so fewer
+ * and larger inference runs are made, see ml_model_params::max_batch_size.
+ *
+ * @param[in] model   A valid model handle.
+ * @param[in] inputs  An array of valid input image descriptors.
+ * @param[in] outputs An array of valid output image descriptors.
+ * @param[in] count   The number of elements in each of the arrays.
+ *
+ * @return ML_OK in case of success, ML_FAIL otherwise.
+ *         To get more details in case of failure, call mlGetModelError().
+ */
+ML_API_ENTRY ml_status mlInferBatch(ml_model model,
+                                    ml_image const* inputs,
+                                    ml_image const* outputs,
+                                    size_t count);
+
+/**
+ * Queues inference of an input image into an output image and returns
+ * immediately. Inferences queued for a model are run one by one
+ * in the order of the calls, on a thread owned by the library.
+ * The images must not be used until the operation is complete.
+ *
+ * @param[in] model     A valid model handle.
+ * @param[in] input     A valid input image descriptor.
+ * @param[in] output    A valid output image descriptor.
+ * @param[in] callback  A function called from the inference thread when
+ *                      the operation is complete, may be null. The callback
+ *                      must not release the model, since releasing waits
+ *                      for the inference thread, which runs the callback.
+ *                      Signal another thread to release it instead.
+ * @param[in] user_data A pointer passed to the callback.
+ *
+ * @return A valid event handle in case of success, ML_INVALID_HANDLE
+ *         otherwise. The event is signalled after the callback returns.
+ *         The event should be released with mlReleaseEvent(), it may be
+ *         released before the operation is complete.
+ *         To get more details in case of failure, call mlGetModelError().
+ */
+ML_API_ENTRY ml_event mlInferAsync(ml_model model,
+                                   ml_image input,
+                                   ml_image output,
+                                   ml_callback callback,
+                                   void* user_data);
+
+/**
+ * Returns performance statistics of a model: timings and histograms of
+ * inference phases, moved bytes and loading times. Inferences run with
+ * all functions are counted, concurrent ones included.
+ *
+ * @param[in]  model A valid model handle.
+ * @param[out] stats A pointer to the result statistics structure.
+ *
+ * @return ML_OK in case of success, ML_FAIL otherwise.
+ *         To get more details in case of failure, call mlGetModelError().
+ */
+ML_API_ENTRY ml_status mlGetModelStats(ml_model model, ml_model_stats* stats);
+
+/**
+ * Resets inference statistics of a model, loading times are kept.
+ *
+ * @param[in] model A valid model handle.
+ */
+ML_API_ENTRY void mlResetModelStats(ml_model model);
+
 /**
  * Releases a model loaded with mlCreateModel(), invalidates the handle.
+ * Inferences queued with mlInferAsync() are finished first, so the model
+ * must not be released from their callbacks.
  *
  * @param model A valid model handle.
  */
 ML_API_ENTRY void mlReleaseModel(ml_model model);
 
 
+/**
+ * Returns an asynchronous operation state without waiting.
+ *
+ * @param[in] event A valid event handle.
+ *
+ * @return The operation state, ML_EVENT_FAILED for a bad handle.
+ */
+ML_API_ENTRY ml_event_status mlGetEventStatus(ml_event event);
+
+/**
+ * Waits for an asynchronous operation to complete.
+ *
+ * @param[in] event A valid event handle.
+ *
+ * @return ML_OK if the operation has succeeded, ML_FAIL otherwise.
+ *         To get more details in case of failure, call mlGetEventError().
+ */
+ML_API_ENTRY ml_status mlWaitEvent(ml_event event);
+
+/**
+ * Returns a formatted message with the error of a failed
+ * asynchronous operation.
+ *
+ * @param[in]  event       A valid event handle.
+ * @param[out] buffer      A buffer for the message.
+ * @param[in]  buffer_size The buffer size, in bytes.
+ *
+ * @return The formatted message.
+ */
+ML_API_ENTRY char* mlGetEventError(ml_event event, char* buffer, size_t buffer_size);
+
+/**
+ * Releases an event, invalidates the handle.
+ *
+ * @param[in] event A valid event handle.
+ */
+ML_API_ENTRY void mlReleaseEvent(ml_event event);
+
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,416 @@
+#include "arg_parser.h"
+#include "model_runner.h"
+#include "tool_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+typedef std::chrono::steady_clock Clock;
+
+struct TestParams
+{
+    std::string model_path;
+    size_t width;
+    size_t height;
+    size_t iterations;
+    double max_ms;
+    double max_tile_error;
+};
+
+void Check(bool condition, const std::string& message)
+{
+    if (!condition)
+    {
+        throw std::runtime_error(message);
+    }
+}
+
+typedef decltype(MakeReleaser(ml_context(), &mlReleaseContext)) ContextReleaser;
+typedef decltype(MakeReleaser(ml_model(), &mlReleaseModel)) ModelReleaser;
+typedef decltype(MakeReleaser(ml_image(), &mlReleaseImage)) ImageReleaser;
+
+ml_context CreateContext()
+{
+    ml_context context = mlCreateContext();
+    Check(context != nullptr, "Error creating context");
+    return context;
+}
+
+ml_model CreateModel(ml_context context, const TestParams& test, ml_model_params params = {})
+{
+    params.model_path = test.model_path.c_str();
+
+    ml_model model = mlCreateModel(context, &params);
+    CheckContextStatus(context, model != nullptr);
+    return model;
+}
+
+// Sets the model input to the test resolution
+void SetInputSize(ml_model model, const TestParams& test)
+{
+    ml_image_info input_info;
+    CheckModelStatus(model, mlGetModelInfo(model, &input_info, nullptr) == ML_OK);
+
+    input_info.width = test.width;
+    input_info.height = test.height;
+    CheckModelStatus(model, mlSetModelInputInfo(model, &input_info) == ML_OK);
+}
+
+ml_image CreateImage(ml_context context, const ml_image_info& info)
+{
+    ml_image image = mlCreateImage(context, &info);
+    CheckContextStatus(context, image != nullptr);
+    return image;
+}
+
+void FillImage(ml_image image, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> distribution(0, 1);
+
+    size_t size;
+    auto data = static_cast<float*>(mlMapImage(image, &size));
+    Check(data != nullptr, "Error mapping image");
+    std::generate(data, data + size / sizeof(float), [&] { return distribution(random); });
+    mlUnmapImage(image, data);
+}
+
+std::vector<float> ReadImage(ml_image image)
+{
+    size_t size;
+    auto data = static_cast<float*>(mlMapImage(image, &size));
+    Check(data != nullptr, "Error mapping image");
+    std::vector<float> values(data, data + size / sizeof(float));
+    mlUnmapImage(image, data);
+    return values;
+}
+
+double GetMaxError(const std::vector<float>& expected, const std::vector<float>& actual)
+{
+    Check(expected.size() == actual.size(), "Image sizes differ");
+
+    double max_error = 0;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        Check(std::isfinite(actual[i]), "Non-finite result at " + std::to_string(i));
+        max_error = std::max<double>(max_error, std::abs(expected[i] - actual[i]));
+    }
+    return max_error;
+}
+
+struct Fixture
+{
+    explicit Fixture(const TestParams& test)
+        : context(CreateContext())
+        , context_releaser(MakeReleaser(context, &mlReleaseContext))
+        , model(CreateModel(context, test))
+        , model_releaser(MakeReleaser(model, &mlReleaseModel))
+    {
+        SetInputSize(model, test);
+        CheckModelStatus(model, mlGetModelInfo(model, &input_info, &output_info) == ML_OK);
+    }
+
+    // Infers a seeded random input with new images
+    std::vector<float> Infer(unsigned seed)
+    {
+        ml_image input = CreateImage(context, input_info);
+        auto input_releaser = MakeReleaser(input, &mlReleaseImage);
+
+        ml_image output = CreateImage(context, output_info);
+        auto output_releaser = MakeReleaser(output, &mlReleaseImage);
+
+        FillImage(input, seed);
+        CheckModelStatus(model, mlInfer(model, input, output) == ML_OK);
+        return ReadImage(output);
+    }
+
+    ml_context context;
+    ContextReleaser context_releaser;
+    ml_model model;
+    ModelReleaser model_releaser;
+    ml_image_info input_info;
+    ml_image_info output_info;
+};
+
+void TestModelInfo(const TestParams& test)
+{
+    Fixture fixture(test);
+
+    Check(fixture.input_info.dtype == ML_FLOAT32, "Unexpected input data type");
+    Check(fixture.input_info.width == test.width && fixture.input_info.height == test.height,
+          "Input dimensions are not set");
+    Check(fixture.output_info.width == test.width && fixture.output_info.height == test.height,
+          "Output dimensions do not match the input");
+    Check(fixture.output_info.channels != 0, "Output channels are not detected");
+}
+
+void TestDeterminism(const TestParams& test)
+{
+    Fixture fixture(test);
+
+    auto first = fixture.Infer(1);
+    auto second = fixture.Infer(1);
+    Check(GetMaxError(first, second) == 0, "Results of the same input differ");
+    Check(GetMaxError(first, fixture.Infer(2)) != 0, "Results do not depend on the input");
+}
+
+void TestBatch(const TestParams& test)
+{
+    Fixture fixture(test);
+    constexpr size_t kBatchSize = 3;
+
+    std::vector<ImageReleaser> image_releasers;
+    std::vector<ml_image> inputs;
+    std::vector<ml_image> outputs;
+
+    for (size_t i = 0; i < kBatchSize; i++)
+    {
+        inputs.push_back(CreateImage(fixture.context, fixture.input_info));
+        image_releasers.push_back(MakeReleaser(inputs.back(), &mlReleaseImage));
+        FillImage(inputs.back(), i);
+
+        outputs.push_back(CreateImage(fixture.context, fixture.output_info));
+        image_releasers.push_back(MakeReleaser(outputs.back(), &mlReleaseImage));
+    }
+
+    CheckModelStatus(fixture.model, mlInferBatch(fixture.model, inputs.data(),
+                                                 outputs.data(), kBatchSize) == ML_OK);
+
+    // Kernels may sum in a different order for a batch
+    for (size_t i = 0; i < kBatchSize; i++)
+    {
+        double error = GetMaxError(fixture.Infer(i), ReadImage(outputs[i]));
+        Check(error < 1e-4, "Batch result " + std::to_string(i) + " differs by " + std::to_string(error));
+    }
+}
+
+void TestExternalMemory(const TestParams& test)
+{
+    Fixture fixture(test);
+    auto expected = fixture.Infer(1);
+
+    auto& input_info = fixture.input_info;
+    auto& output_info = fixture.output_info;
+    size_t input_row_size = input_info.width * input_info.channels * sizeof(float);
+    size_t output_row_size = output_info.width * output_info.channels * sizeof(float);
+
+    // Packed rows are fed as is, padded ones are staged
+    for (size_t padding : { 0, 12 })
+    {
+        size_t input_pitch = input_row_size + padding;
+        size_t output_pitch = output_row_size + padding;
+        std::vector<char> input_data(input_pitch * input_info.height + 64);
+        std::vector<char> output_data(output_pitch * output_info.height + 64);
+
+        auto input_memory = input_data.data() + (64 - reinterpret_cast<uintptr_t>(input_data.data()) % 64);
+        auto output_memory = output_data.data() + (64 - reinterpret_cast<uintptr_t>(output_data.data()) % 64);
+
+        ml_image pooled_input = CreateImage(fixture.context, input_info);
+        auto pooled_input_releaser = MakeReleaser(pooled_input, &mlReleaseImage);
+        FillImage(pooled_input, 1);
+        auto input_values = ReadImage(pooled_input);
+
+        for (size_t y = 0; y < input_info.height; y++)
+        {
+            std::memcpy(input_memory + y * input_pitch,
+                        input_values.data() + y * input_row_size / sizeof(float), input_row_size);
+        }
+
+        ml_image input = mlCreateImageFromMemory(fixture.context, &input_info, input_memory,
+                                                 padding != 0 ? input_pitch : 0, nullptr);
+        CheckContextStatus(fixture.context, input != nullptr);
+        auto input_releaser = MakeReleaser(input, &mlReleaseImage);
+
+        ml_image output = mlCreateImageFromMemory(fixture.context, &output_info, output_memory,
+                                                  padding != 0 ? output_pitch : 0, nullptr);
+        CheckContextStatus(fixture.context, output != nullptr);
+        auto output_releaser = MakeReleaser(output, &mlReleaseImage);
+
+        CheckModelStatus(fixture.model, mlInfer(fixture.model, input, output) == ML_OK);
+
+        std::vector<float> actual;
+        for (size_t y = 0; y < output_info.height; y++)
+        {
+            auto row = reinterpret_cast<float*>(output_memory + y * output_pitch);
+            actual.insert(actual.end(), row, row + output_row_size / sizeof(float));
+        }
+
+        Check(GetMaxError(expected, actual) == 0,
+              "Result in caller-owned memory differs, row padding " + std::to_string(padding));
+    }
+}
+
+void TestTiling(const TestParams& test)
+{
+    Fixture fixture(test);
+    auto expected = fixture.Infer(1);
+
+    ml_model_params params = {};
+    params.tile_size = std::max<size_t>(std::max(test.width, test.height) / 2, 64);
+    params.tile_halo = params.tile_size / 2;
+
+    ml_model model = CreateModel(fixture.context, test, params);
+    auto model_releaser = MakeReleaser(model, &mlReleaseModel);
+    SetInputSize(model, test);
+
+    ml_image input = CreateImage(fixture.context, fixture.input_info);
+    auto input_releaser = MakeReleaser(input, &mlReleaseImage);
+
+    ml_image output = CreateImage(fixture.context, fixture.output_info);
+    auto output_releaser = MakeReleaser(output, &mlReleaseImage);
+
+    FillImage(input, 1);
+    CheckModelStatus(model, mlInfer(model, input, output) == ML_OK);
+
+    // Tiles see less context than the whole image, so the results are close
+    // rather than equal for models with a large receptive field. The error
+    // is relative to the output range, which depends on the random weights.
+    double range = 0;
+    for (float value : expected)
+    {
+        range = std::max<double>(range, std::abs(value));
+    }
+    Check(range > 0, "Output is zero");
+
+    double error = GetMaxError(expected, ReadImage(output)) / range;
+    std::cerr << "  max relative tile error: " << error << "\n";
+    Check(error <= test.max_tile_error, "Tiled result differs by " + std::to_string(error));
+}
+
+void TestBufferReuse(const TestParams& test)
+{
+    Fixture fixture(test);
+    fixture.Infer(1);
+
+    ml_image_pool_stats before;
+    CheckContextStatus(fixture.context, mlGetImagePoolStats(fixture.context, &before) == ML_OK);
+
+    fixture.Infer(1);
+
+    ml_image_pool_stats after;
+    CheckContextStatus(fixture.context, mlGetImagePoolStats(fixture.context, &after) == ML_OK);
+
+    // Steady-state inferences of the same size reuse all image and staging buffers
+    Check(after.allocation_count > before.allocation_count, "No buffers are requested");
+    Check(after.hit_count - before.hit_count == after.allocation_count - before.allocation_count,
+          "Buffers are allocated in the steady state");
+}
+
+void TestTiming(const TestParams& test)
+{
+    Fixture fixture(test);
+    ml_image input = CreateImage(fixture.context, fixture.input_info);
+    auto input_releaser = MakeReleaser(input, &mlReleaseImage);
+
+    ml_image output = CreateImage(fixture.context, fixture.output_info);
+    auto output_releaser = MakeReleaser(output, &mlReleaseImage);
+
+    FillImage(input, 1);
+
+    // The first inference initializes kernels
+    CheckModelStatus(fixture.model, mlInfer(fixture.model, input, output) == ML_OK);
+    mlResetModelStats(fixture.model);
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < test.iterations; i++)
+    {
+        CheckModelStatus(fixture.model, mlInfer(fixture.model, input, output) == ML_OK);
+    }
+    double mean_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / test.iterations;
+
+    ml_model_stats stats;
+    CheckModelStatus(fixture.model, mlGetModelStats(fixture.model, &stats) == ML_OK);
+
+    auto& session = stats.phases[ML_STATS_SESSION];
+    Check(stats.phases[ML_STATS_TOTAL].count == test.iterations, "Inferences are not counted");
+
+    std::cerr << "  " << test.width << "x" << test.height << ": mean " << mean_ms << " ms, session min "
+              << session.min_ms << " ms, max " << session.max_ms << " ms, "
+              << test.width * test.height / mean_ms / 1e3 << " Mpix/s\n";
+
+    if (test.max_ms > 0)
+    {
+        Check(mean_ms <= test.max_ms, "Mean inference time " + std::to_string(mean_ms) +
+              " ms exceeds " + std::to_string(test.max_ms) + " ms");
+    }
+}
+
+
+int main(int argc, char* argv[])
+try
+{
+    ArgParser parser;
+    TestParams test;
+
+    parser.AddArg(&test.model_path, "m",
+                  "Path to a float32 image model, e.g. generated by model_generator");
+
+    test.width = 256;
+    parser.AddArg(&test.width, "width", "Input width, 256 if omitted", true);
+
+    test.height = 192;
+    parser.AddArg(&test.height, "height", "Input height, 192 if omitted", true);
+
+    test.iterations = 10;
+    parser.AddArg(&test.iterations, "n", "Timed inferences, 10 if omitted", true);
+
+    test.max_ms = 0;
+    parser.AddArg(&test.max_ms, "max_ms",
+                  "Maximum mean inference time in milliseconds, not checked if omitted", true);
+
+    test.max_tile_error = 0.1;
+    parser.AddArg(&test.max_tile_error, "max_tile_error",
+                  "Maximum difference of tiled results relative to the output range,"
+                  " 0.1 if omitted", true);
+
+    parser.Parse(argc, argv);
+
+    Check(test.width != 0 && test.height != 0 && test.iterations != 0,
+          "Dimensions and iteration count must not be 0");
+
+    const std::vector<std::pair<char const*, std::function<void(const TestParams&)>>> tests = {
+        { "ModelInfo", &TestModelInfo },
+        { "Determinism", &TestDeterminism },
+        { "Batch", &TestBatch },
+        { "ExternalMemory", &TestExternalMemory },
+        { "Tiling", &TestTiling },
+        { "BufferReuse", &TestBufferReuse },
+        { "Timing", &TestTiming },
+    };
+
+    size_t failure_count = 0;
+
+    for (auto& name_test : tests)
+    {
+        std::cerr << "[ RUN    ] " << name_test.first << "\n";
+        try
+        {
+            name_test.second(test);
+            std::cerr << "[     OK ] " << name_test.first << "\n";
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "[ FAILED ] " << name_test.first << ": " << e.what() << "\n";
+            failure_count++;
+        }
+    }
+
+    std::cerr << tests.size() - failure_count << " of " << tests.size() << " tests passed\n";
+    return failure_count == 0 ? 0 : 1;
+}
+catch (std::exception& e)
+{
+    std::cerr << e.what() << std::endl;
+    return -1;
+}
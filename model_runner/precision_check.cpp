@@ -0,0 +1,198 @@
+#include "arg_parser.h"
+#include "model_runner.h"
+#include "tool_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+ml_precision ParsePrecision(const std::string& precision)
+{
+    if (precision == "float16")
+    {
+        return ML_PRECISION_FLOAT16;
+    }
+    if (precision == "mixed")
+    {
+        return ML_PRECISION_MIXED;
+    }
+    throw std::runtime_error("Unknown precision: " + precision);
+}
+
+std::vector<float> ReadInput(const std::string& input_file, size_t size)
+{
+    std::vector<float> input(size);
+
+    if (input_file.empty())
+    {
+        // Values in the [0, 1] range, as in normalized images
+        std::mt19937 generator;
+        std::uniform_real_distribution<float> distribution(0.f, 1.f);
+        std::generate(input.begin(), input.end(), [&] { return distribution(generator); });
+        return input;
+    }
+
+    std::ifstream stream(input_file, std::ios_base::binary);
+    stream.read(reinterpret_cast<char*>(input.data()), size * sizeof(float));
+    if (stream.gcount() != static_cast<std::streamsize>(size * sizeof(float)))
+    {
+        throw std::runtime_error("Error reading " + input_file + ", expected "
+                                 + std::to_string(size * sizeof(float)) + " bytes");
+    }
+    return input;
+}
+
+// Runs the model with the given precision and returns the output data
+std::vector<float> RunModel(ml_context context,
+                            ml_model_params params,
+                            ml_precision precision,
+                            size_t width,
+                            size_t height,
+                            const std::string& input_file)
+{
+    params.precision = precision;
+
+    ml_model model = mlCreateModel(context, &params);
+    CheckContextStatus(context, model != nullptr);
+
+    auto model_releaser = MakeReleaser(model, &mlReleaseModel);
+
+    ml_image_info input_info;
+    ml_image_info output_info;
+    CheckModelStatus(model, mlGetModelInfo(model, &input_info, nullptr) == ML_OK);
+
+    input_info.width = width;
+    input_info.height = height;
+    CheckModelStatus(model, mlSetModelInputInfo(model, &input_info) == ML_OK);
+    CheckModelStatus(model, mlGetModelInfo(model, &input_info, &output_info) == ML_OK);
+
+    if (input_info.dtype != ML_FLOAT32 || output_info.dtype != ML_FLOAT32)
+    {
+        throw std::runtime_error("Only models with float32 input and output are supported");
+    }
+
+    ml_image input_image = mlCreateImage(context, &input_info);
+    CheckContextStatus(context, input_image != ML_INVALID_HANDLE);
+
+    auto input_image_releaser = MakeReleaser(input_image, &mlReleaseImage);
+
+    ml_image output_image = mlCreateImage(context, &output_info);
+    CheckContextStatus(context, output_image != ML_INVALID_HANDLE);
+
+    auto output_image_releaser = MakeReleaser(output_image, &mlReleaseImage);
+
+    size_t input_size;
+    void* input_data = mlMapImage(input_image, &input_size);
+    auto input = ReadInput(input_file, input_size / sizeof(float));
+    std::memcpy(input_data, input.data(), input_size);
+    mlUnmapImage(input_image, input_data);
+
+    CheckModelStatus(model, mlInfer(model, input_image, output_image) == ML_OK);
+
+    size_t output_size;
+    void* output_data = mlMapImage(output_image, &output_size);
+    std::vector<float> output(output_size / sizeof(float));
+    std::memcpy(output.data(), output_data, output_size);
+    mlUnmapImage(output_image, output_data);
+
+    return output;
+}
+
+
+int main(int argc, char* argv[])
+try
+{
+    ArgParser parser;
+
+    std::string model_path;
+    parser.AddArg(&model_path, "m", "Path to TensorFlow model (protobuf format)");
+
+    std::string input_node;
+    parser.AddArg(&input_node, "in", "Input node name, autodetect if omitted", true);
+
+    std::string output_node;
+    parser.AddArg(&output_node, "on", "Output node name, autodetect if omitted", true);
+
+    std::string input_file;
+    parser.AddArg(&input_file, "i", "File with float32 input data, random data if omitted", true);
+
+    std::size_t width = 0;
+    parser.AddArg(&width, "w", "Input image width");
+
+    std::size_t height = 0;
+    parser.AddArg(&height, "h", "Input image height");
+
+    std::string precision = "mixed";
+    parser.AddArg(&precision, "p", "Checked precision: float16 or mixed, mixed if omitted", true);
+
+    double max_error = 0;
+    parser.AddArg(&max_error, "max_error",
+                  "Maximum allowed absolute error, not checked if omitted", true);
+
+    parser.Parse(argc, argv);
+
+    ml_context context = mlCreateContext();
+    if (context == ML_INVALID_HANDLE)
+    {
+        throw std::runtime_error("Error creating context");
+    }
+
+    auto context_releaser = MakeReleaser(context, &mlReleaseContext);
+
+    ml_model_params params = {};
+    params.model_path = model_path.c_str();
+    params.input_node = input_node.empty() ? nullptr : input_node.c_str();
+    params.output_node = output_node.empty() ? nullptr : output_node.c_str();
+
+    auto reference = RunModel(context, params, ML_PRECISION_DEFAULT, width, height, input_file);
+    auto result = RunModel(context, params, ParsePrecision(precision), width, height, input_file);
+
+    // Absolute and relative errors, relative to the reference value range
+    double abs_error_max = 0;
+    double abs_error_sum = 0;
+    double squared_error_sum = 0;
+    auto range = std::minmax_element(reference.begin(), reference.end());
+    double value_range = reference.empty() ? 0 : *range.second - *range.first;
+
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        double error = std::abs(static_cast<double>(result[i]) - reference[i]);
+        abs_error_max = std::max(abs_error_max, std::isnan(error) ? INFINITY : error);
+        abs_error_sum += error;
+        squared_error_sum += error * error;
+    }
+
+    size_t count = std::max<size_t>(reference.size(), 1);
+    double rmse = std::sqrt(squared_error_sum / count);
+
+    std::cout << "Precision: " << precision << "\n"
+              << "Values: " << reference.size() << "\n"
+              << "Max absolute error: " << abs_error_max << "\n"
+              << "Mean absolute error: " << abs_error_sum / count << "\n"
+              << "RMSE: " << rmse << "\n";
+
+    if (rmse > 0 && value_range > 0)
+    {
+        std::cout << "PSNR: " << 20 * std::log10(value_range / rmse) << " dB\n";
+    }
+
+    if (max_error > 0 && abs_error_max > max_error)
+    {
+        std::cerr << "Max absolute error exceeds " << max_error << std::endl;
+        return 1;
+    }
+}
+catch (std::exception& e)
+{
+    std::cerr << e.what() << std::endl;
+    return -1;
+}
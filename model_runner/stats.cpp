@@ -0,0 +1,123 @@
+#include "stats.h"
+
+#include <limits>
+
+
+namespace ML {
+
+namespace {
+
+// The first histogram bucket holds times under 64 us, each next one
+// twice longer times
+constexpr uint64_t kFirstBucketNs = 64000;
+
+size_t GetHistogramBucket(uint64_t ns)
+{
+    size_t bucket = 0;
+    for (uint64_t limit = kFirstBucketNs; ns >= limit && bucket + 1 < ML_STATS_HISTOGRAM_SIZE; limit *= 2)
+    {
+        bucket++;
+    }
+    return bucket;
+}
+
+template<class Compare>
+void UpdateExtremum(std::atomic<uint64_t>& value, uint64_t candidate, Compare compare)
+{
+    uint64_t current = value.load(std::memory_order_relaxed);
+    while (compare(candidate, current) &&
+           !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed))
+    {
+    }
+}
+
+double ToMilliseconds(uint64_t ns)
+{
+    return ns / 1e6;
+}
+
+} // namespace
+
+ModelStats::ModelStats()
+{
+    Reset();
+}
+
+void ModelStats::AddPhaseTime(ml_stats_phase phase, std::chrono::steady_clock::duration time)
+{
+#if ML_COLLECT_STATS
+    auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+    auto& stats = m_phases[phase];
+
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    stats.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    stats.histogram[GetHistogramBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    UpdateExtremum(stats.min_ns, ns, [](uint64_t a, uint64_t b) { return a < b; });
+    UpdateExtremum(stats.max_ns, ns, [](uint64_t a, uint64_t b) { return a > b; });
+#else
+    (void)phase;
+    (void)time;
+#endif
+}
+
+void ModelStats::AddInputBytes(size_t bytes)
+{
+#if ML_COLLECT_STATS
+    m_input_bytes.fetch_add(bytes, std::memory_order_relaxed);
+#else
+    (void)bytes;
+#endif
+}
+
+void ModelStats::AddOutputBytes(size_t bytes)
+{
+#if ML_COLLECT_STATS
+    m_output_bytes.fetch_add(bytes, std::memory_order_relaxed);
+#else
+    (void)bytes;
+#endif
+}
+
+void ModelStats::Get(ml_model_stats* stats) const
+{
+    for (size_t i = 0; i < ML_STATS_PHASE_COUNT; i++)
+    {
+        auto& phase = m_phases[i];
+        auto& phase_stats = stats->phases[i];
+
+        phase_stats.count = phase.count.load(std::memory_order_relaxed);
+        phase_stats.total_ms = ToMilliseconds(phase.total_ns.load(std::memory_order_relaxed));
+        phase_stats.max_ms = ToMilliseconds(phase.max_ns.load(std::memory_order_relaxed));
+        phase_stats.min_ms = phase_stats.count != 0 ?
+            ToMilliseconds(phase.min_ns.load(std::memory_order_relaxed)) : 0;
+
+        for (size_t bucket = 0; bucket < ML_STATS_HISTOGRAM_SIZE; bucket++)
+        {
+            phase_stats.histogram[bucket] = phase.histogram[bucket].load(std::memory_order_relaxed);
+        }
+    }
+
+    stats->input_bytes = m_input_bytes.load(std::memory_order_relaxed);
+    stats->output_bytes = m_output_bytes.load(std::memory_order_relaxed);
+}
+
+void ModelStats::Reset()
+{
+    for (auto& phase : m_phases)
+    {
+        phase.count = 0;
+        phase.total_ns = 0;
+        phase.min_ns = std::numeric_limits<uint64_t>::max();
+        phase.max_ns = 0;
+
+        for (auto& bucket : phase.histogram)
+        {
+            bucket = 0;
+        }
+    }
+
+    m_input_bytes = 0;
+    m_output_bytes = 0;
+}
+
+} // namespace ML
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "model_runner.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Performance counters cost a few relaxed atomic operations per phase,
+// define as 0 to compile them out
+#ifndef ML_COLLECT_STATS
+#define ML_COLLECT_STATS 1
+#endif
+
+
+namespace ML {
+
+/**
+ * Inference phase timings, call counts and moved bytes of a model.
+ * Updated concurrently by inferences without locking.
+ */
+class ModelStats
+{
+public:
+    ModelStats();
+
+    void AddPhaseTime(ml_stats_phase phase, std::chrono::steady_clock::duration time);
+    void AddInputBytes(size_t bytes);
+    void AddOutputBytes(size_t bytes);
+
+    // Fills the inference counters, the load statistics are left intact
+    void Get(ml_model_stats* stats) const;
+    void Reset();
+
+private:
+    struct Phase
+    {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_ns;
+        std::atomic<uint64_t> min_ns;
+        std::atomic<uint64_t> max_ns;
+        std::atomic<uint64_t> histogram[ML_STATS_HISTOGRAM_SIZE];
+    };
+
+    Phase m_phases[ML_STATS_PHASE_COUNT];
+    std::atomic<uint64_t> m_input_bytes;
+    std::atomic<uint64_t> m_output_bytes;
+};
+
+/**
+ * Adds the time from construction to destruction, or to an earlier Stop(),
+ * to a phase.
+ */
+class StatsTimer
+{
+public:
+    StatsTimer(ModelStats& stats, ml_stats_phase phase)
+#if ML_COLLECT_STATS
+        : m_stats(stats)
+        , m_phase(phase)
+        , m_start(std::chrono::steady_clock::now())
+#endif
+    {
+#if !ML_COLLECT_STATS
+        (void)stats;
+        (void)phase;
+#endif
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+    StatsTimer& operator=(const StatsTimer&) = delete;
+
+    ~StatsTimer()
+    {
+        Stop();
+    }
+
+    void Stop()
+    {
+#if ML_COLLECT_STATS
+        if (!m_stopped)
+        {
+            m_stats.AddPhaseTime(m_phase, std::chrono::steady_clock::now() - m_start);
+            m_stopped = true;
+        }
+#endif
+    }
+
+private:
+#if ML_COLLECT_STATS
+    ModelStats& m_stats;
+    ml_stats_phase m_phase;
+    std::chrono::steady_clock::time_point m_start;
+    bool m_stopped = false;
+#endif
+};
+
+} // namespace ML
@@ -1,139 +1,31 @@
+#include "arg_parser.h"
 #include "model_runner.h"
+#include "tool_utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <exception>
 #include <fstream>
-#include <iomanip>
+#include <functional>
 #include <iostream>
-#include <map>
 #include <memory>
+#include <mutex>
+#include <queue>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 #ifdef _WIN32
 #include <Windows.h>
 #else
 #include <dlfcn.h>
+#include <glob.h>
+#include <sys/stat.h>
 #endif
 
 
-class ArgParser
-{
-public:
-    template<class T>
-    void AddArg(T* value, const std::string& name, std::string help, bool optional = false)
-    {
-        std::unique_ptr<ArgImpl<T>> arg(new ArgImpl<T>);
-        arg->name = "-" + name;
-        arg->help = std::move(help);
-        arg->value = value;
-        arg->has_value = optional;
-        args_.insert(std::make_pair("-" + name, std::move(arg)));
-    }
-
-    void Parse(int argc, char* argv[])
-    {
-        for (int i = 1; i < argc; ++i)
-        {
-            if (argv[i] == std::string("-help"))
-            {
-                throw std::runtime_error(HelpString());
-            }
-
-            if (argv[i][0] == '-')
-            {
-                if (i % 2 != 1)
-                {
-                    throw std::runtime_error("Missing option value: " + std::string(argv[i - 1]));
-                }
-            }
-            else
-            {
-                if (i % 2 != 0)
-                {
-                    throw std::runtime_error("Missing option name: " + std::string(argv[i])
-                                             + "\n" + HelpString());
-                }
-                auto arg = args_.find(argv[i - 1]);
-                if (arg == args_.end())
-                {
-                    throw std::runtime_error("Unknown option: " + std::string(argv[i - 1])
-                                             + "\n" + HelpString());
-                }
-                arg->second->Parse(argv[i]);
-            }
-        }
-
-        for (auto& arg : args_)
-        {
-            if (!arg.second->has_value)
-            {
-                throw std::runtime_error("Missing option: " + arg.second->name
-                                         + "\n" + HelpString());
-            }
-        }
-    }
-
-private:
-    struct Arg
-    {
-        virtual void Parse(const std::string& value) = 0;
-
-        std::string name;
-        std::string help;
-        bool has_value = false;
-    };
-
-    template<class T>
-    struct ArgImpl : Arg
-    {
-        void Parse(const std::string& string) override
-        {
-            std::istringstream stream(string);
-            stream >> *value;
-            if (stream.fail() && ! stream.eof())
-            {
-                throw std::runtime_error("Bad parameter " + name + ": " + string);
-            }
-            has_value = true;
-        }
-
-        T* value = nullptr;
-    };
-
-    std::string HelpString() const
-    {
-        std::ostringstream stream;
-        stream << "Available options:\n";
-        for (auto& arg : args_)
-        {
-            stream << std::setw(5) << std::setfill(' ') << "" << arg.second->name
-                << ": " << arg.second->help << "\n";
-        }
-        return stream.str();
-    }
-
-    std::map<std::string, std::unique_ptr<Arg>> args_;
-};
-
-
-void CheckContextStatus(ml_context context, bool status)
-{
-    if (!status)
-    {
-        std::vector<char> buffer(1024);
-        throw std::runtime_error(mlGetContextError(context, buffer.data(), buffer.size()));
-    }
-}
-
-void CheckModelStatus(ml_model model, bool status)
-{
-    if (!status)
-    {
-        std::vector<char> buffer(1024);
-        throw std::runtime_error(mlGetModelError(model, buffer.data(), buffer.size()));
-    }
-}
-
 std::string ReadInput(const std::string& input_file)
 {
     std::istream* input_stream;
@@ -192,12 +84,390 @@ void WriteOutput(const std::string& output_file, const std::string& output)
 }
 
 
+bool IsDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    struct stat status;
+    return stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+#endif
+}
+
+bool HasWildcards(const std::string& path)
+{
+    return path.find_first_of("*?") != std::string::npos;
+}
+
+std::string GetFileName(const std::string& path)
+{
+    size_t separator = path.find_last_of("/\\");
+    return separator != std::string::npos ? path.substr(separator + 1) : path;
+}
+
+// Lists the files of a directory or matching a wildcard pattern, sorted by name
+std::vector<std::string> ListInputFiles(const std::string& input)
+{
+    std::string pattern = IsDirectory(input) ? input + "/*" : input;
+    std::vector<std::string> files;
+
+#ifdef _WIN32
+    std::string directory = pattern.substr(0, pattern.size() - GetFileName(pattern).size());
+
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA(pattern.c_str(), &find_data);
+    if (find_handle != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+            {
+                files.push_back(directory + find_data.cFileName);
+            }
+        }
+        while (FindNextFileA(find_handle, &find_data));
+        FindClose(find_handle);
+    }
+#else
+    glob_t glob_result = {};
+    if (glob(pattern.c_str(), 0, nullptr, &glob_result) == 0)
+    {
+        for (size_t i = 0; i < glob_result.gl_pathc; i++)
+        {
+            if (!IsDirectory(glob_result.gl_pathv[i]))
+            {
+                files.push_back(glob_result.gl_pathv[i]);
+            }
+        }
+    }
+    globfree(&glob_result);
+#endif
+
+    if (files.empty())
+    {
+        throw std::runtime_error("No input files found: " + input);
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+
 template<class T>
-auto MakeReleaser(T handle, void(* release_func)(T))
+class BlockingQueue
+{
+public:
+    void Push(T value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_items.push(std::move(value));
+        m_condition.notify_one();
+    }
+
+    // Returns false if the queue is closed and empty
+    bool Pop(T& value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return !m_items.empty() || m_closed; });
+        if (m_items.empty())
+        {
+            return false;
+        }
+        value = std::move(m_items.front());
+        m_items.pop();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_condition.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::queue<T> m_items;
+    bool m_closed = false;
+};
+
+struct Frame
+{
+    ml_image input = ML_INVALID_HANDLE;
+    ml_image output = ML_INVALID_HANDLE;
+    std::string input_path; // Empty for frames of a stream
+    size_t index = 0;
+};
+
+struct SequenceParams
+{
+    std::string input_file;  // File, directory or wildcard pattern
+    std::string output_file; // Output directory for several input files
+    size_t frame_count;      // Frames concatenated in a stream, 0 if unknown
+};
+
+// Reads a frame straight into the mapped image memory, returns false
+// if the stream ends before the frame
+bool ReadFrame(std::istream& stream, ml_image image)
+{
+    size_t size;
+    void* data = mlMapImage(image, &size);
+    if (data == nullptr)
+    {
+        throw std::runtime_error("Error mapping input image");
+    }
+
+    stream.read(static_cast<char*>(data), size);
+    size_t read_size = static_cast<size_t>(stream.gcount());
+    mlUnmapImage(image, data);
+
+    if (read_size != 0 && read_size != size)
+    {
+        throw std::runtime_error("Bad input size: " + std::to_string(read_size)
+                                 + " bytes left, expected: " + std::to_string(size));
+    }
+    return read_size == size;
+}
+
+// Writes a frame straight from the mapped image memory
+void WriteFrame(std::ostream& stream, ml_image image)
+{
+    size_t size;
+    void* data = mlMapImage(image, &size);
+    if (data == nullptr)
+    {
+        throw std::runtime_error("Error mapping output image");
+    }
+
+    stream.write(static_cast<char*>(data), size);
+    mlUnmapImage(image, data);
+
+    if (stream.fail())
+    {
+        throw std::runtime_error("Error writing output");
+    }
+}
+
+// Runs a three-stage pipeline: frames are read, inferred and written
+// by separate threads, so file I/O of neighbouring frames overlaps
+// the inference. The model is loaded once for the whole sequence.
+void RunSequence(const SequenceParams& sequence,
+                 ml_context context,
+                 ml_model model,
+                 const ml_image_info& input_info,
+                 const ml_image_info& output_info)
 {
-    auto release = [handle, release_func](void*) { release_func(handle); };
-    std::unique_ptr<void, decltype(release)> releaser(&handle, release);
-    return releaser;
+    constexpr size_t kFramesInFlight = 3;
+
+    // Several files are read one by one, otherwise frames are concatenated
+    bool is_file_list = IsDirectory(sequence.input_file) || HasWildcards(sequence.input_file);
+    std::vector<std::string> input_files;
+    if (is_file_list)
+    {
+        input_files = ListInputFiles(sequence.input_file);
+        std::cerr << "Input files: " << input_files.size() << "\n";
+    }
+
+    std::vector<Frame> frames(kFramesInFlight);
+    auto release_frames = [&frames](void*)
+    {
+        for (auto& frame : frames)
+        {
+            mlReleaseImage(frame.input);
+            mlReleaseImage(frame.output);
+        }
+    };
+    std::unique_ptr<void, decltype(release_frames)> frames_releaser(&frames, release_frames);
+
+    BlockingQueue<Frame*> free_frames;
+    BlockingQueue<Frame*> read_frames;
+    BlockingQueue<Frame*> inferred_frames;
+
+    for (auto& frame : frames)
+    {
+        frame.input = mlCreateImage(context, &input_info);
+        CheckContextStatus(context, frame.input != ML_INVALID_HANDLE);
+
+        frame.output = mlCreateImage(context, &output_info);
+        CheckContextStatus(context, frame.output != ML_INVALID_HANDLE);
+
+        free_frames.Push(&frame);
+    }
+
+    // A failed stage closes all queues, so the other stages stop
+    auto close_queues = [&]
+    {
+        free_frames.Close();
+        read_frames.Close();
+        inferred_frames.Close();
+    };
+
+    auto run_stage = [&close_queues](std::exception_ptr& error, const std::function<void()>& stage)
+    {
+        try
+        {
+            stage();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+            close_queues();
+        }
+    };
+
+    auto read_stage = [&]
+    {
+        std::ifstream input_file_stream;
+        std::istream* input_stream = &input_file_stream;
+
+        if (!is_file_list)
+        {
+            if (sequence.input_file.empty())
+            {
+                freopen(nullptr, "rb", stdin);
+                input_stream = &std::cin;
+            }
+            else
+            {
+                input_file_stream.open(sequence.input_file, std::ios_base::binary);
+                if (input_file_stream.fail())
+                {
+                    throw std::runtime_error("Error reading " + sequence.input_file);
+                }
+            }
+        }
+
+        Frame* frame;
+        for (size_t index = 0; free_frames.Pop(frame); index++)
+        {
+            frame->index = index;
+
+            if (is_file_list)
+            {
+                if (index == input_files.size())
+                {
+                    break;
+                }
+
+                frame->input_path = input_files[index];
+
+                std::ifstream file(frame->input_path, std::ios_base::binary);
+                if (file.fail())
+                {
+                    throw std::runtime_error("Error reading " + frame->input_path);
+                }
+
+                if (!ReadFrame(file, frame->input) || file.peek() != std::char_traits<char>::eof())
+                {
+                    throw std::runtime_error("Bad input size: " + frame->input_path);
+                }
+            }
+            else if ((sequence.frame_count != 0 && index == sequence.frame_count) ||
+                     !ReadFrame(*input_stream, frame->input))
+            {
+                if (sequence.frame_count != 0 && index != sequence.frame_count)
+                {
+                    throw std::runtime_error("Input ended after " + std::to_string(index) + " frames");
+                }
+                break;
+            }
+
+            read_frames.Push(frame);
+        }
+
+        read_frames.Close();
+    };
+
+    auto infer_stage = [&]
+    {
+        Frame* frame;
+        while (read_frames.Pop(frame))
+        {
+            CheckModelStatus(model, mlInfer(model, frame->input, frame->output) == ML_OK);
+            inferred_frames.Push(frame);
+        }
+
+        inferred_frames.Close();
+    };
+
+    size_t written_count = 0;
+
+    auto write_stage = [&]
+    {
+        std::ofstream output_file_stream;
+        std::ostream* output_stream = &output_file_stream;
+
+        // Frames of several files are written into files of the same names
+        bool is_output_directory = is_file_list && !sequence.output_file.empty();
+
+        if (sequence.output_file.empty())
+        {
+            freopen(nullptr, "wb", stdout);
+            output_stream = &std::cout;
+        }
+        else if (!is_output_directory)
+        {
+            output_file_stream.open(sequence.output_file, std::ios_base::binary);
+            if (output_file_stream.fail())
+            {
+                throw std::runtime_error("Error writing " + sequence.output_file);
+            }
+        }
+
+        Frame* frame;
+        while (inferred_frames.Pop(frame))
+        {
+            if (is_output_directory)
+            {
+                auto output_path = sequence.output_file + "/" + GetFileName(frame->input_path);
+                std::ofstream file(output_path, std::ios_base::binary);
+                if (file.fail())
+                {
+                    throw std::runtime_error("Error writing " + output_path);
+                }
+                WriteFrame(file, frame->output);
+            }
+            else
+            {
+                WriteFrame(*output_stream, frame->output);
+            }
+
+            std::cerr << "Frame " << frame->index << " done"
+                      << (frame->input_path.empty() ? "" : ": " + frame->input_path) << "\n";
+
+            written_count++;
+            free_frames.Push(frame);
+        }
+
+        output_stream->flush();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::exception_ptr read_error;
+    std::exception_ptr infer_error;
+    std::exception_ptr write_error;
+
+    std::thread read_thread(run_stage, std::ref(read_error), read_stage);
+    std::thread write_thread(run_stage, std::ref(write_error), write_stage);
+    run_stage(infer_error, infer_stage);
+
+    read_thread.join();
+    write_thread.join();
+
+    for (auto& error : { read_error, infer_error, write_error })
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Processed " << written_count << " frames in " << seconds << " s, "
+              << (seconds > 0 ? written_count / seconds : 0) << " frames per second\n";
 }
 
 
@@ -216,10 +486,18 @@ try
     parser.AddArg(&output_node, "on", "Output node name, autodetect if omitted", true);
 
     std::string input_file;
-    parser.AddArg(&input_file, "i", "File with input data, read data from stdin if omitted", true);
+    parser.AddArg(&input_file, "i", "File with input data, read data from stdin if omitted."
+                  " A directory or a wildcard pattern, e.g. frames/*.bin, selects the sequence"
+                  " mode with a frame per file", true);
 
     std::string output_file;
-    parser.AddArg(&output_file, "o", "File for output data, write to stdout if omitted", true);
+    parser.AddArg(&output_file, "o", "File for output data, write to stdout if omitted."
+                  " An output directory in the sequence mode with a frame per file", true);
+
+    size_t frame_count = 1;
+    parser.AddArg(&frame_count, "frames", "Number of frames concatenated in the input,"
+                  " 0 to read frames until the end of the input, 1 if omitted."
+                  " Several frames select the sequence mode", true);
 
     std::size_t width = 0;
     parser.AddArg(&width, "w", "Input image width");
@@ -279,6 +557,13 @@ try
     std::cerr << "Output: " << output_info.width << " x " << output_info.height
               << " x " << output_info.channels << "\n";
 
+    // Process a sequence of frames with the loaded model
+    if (frame_count != 1 || IsDirectory(input_file) || HasWildcards(input_file))
+    {
+        RunSequence({ input_file, output_file, frame_count }, context, model, input_info, output_info);
+        return 0;
+    }
+
     // Create the input image
     ml_image input_image = mlCreateImage(context, &input_info);
     CheckContextStatus(context, input_image != ML_INVALID_HANDLE);
@@ -0,0 +1,175 @@
+#include "tiling.h"
+
+#include "convert.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace tf = tensorflow;
+
+namespace {
+
+template<class Src, class Dst>
+void BlendTileImpl(const tf::Tensor& tile,
+                   const std::vector<float>& weights_x,
+                   const std::vector<float>& weights_y,
+                   size_t x,
+                   size_t y,
+                   tf::Tensor& image)
+{
+    size_t tile_height = tile.dim_size(1);
+    size_t tile_width = tile.dim_size(2);
+    size_t channels = tile.dim_size(3);
+    size_t image_width = image.dim_size(2);
+
+    auto tile_data = tile.flat<Src>().data();
+    auto image_data = image.flat<Dst>().data();
+
+    for (size_t row = 0; row < tile_height; row++)
+    {
+        auto src = tile_data + row * tile_width * channels;
+        auto dst = image_data + ((y + row) * image_width + x) * channels;
+
+        for (size_t col = 0; col < tile_width; col++)
+        {
+            float weight = weights_x[col] * weights_y[row];
+
+            for (size_t c = 0; c < channels; c++, src++, dst++)
+            {
+                *dst = Dst(static_cast<float>(*dst) + static_cast<float>(*src) * weight);
+            }
+        }
+    }
+}
+
+template<class Src>
+void BlendTileToImage(const tf::Tensor& tile,
+                      const std::vector<float>& weights_x,
+                      const std::vector<float>& weights_y,
+                      size_t x,
+                      size_t y,
+                      tf::Tensor& image)
+{
+    switch (image.dtype())
+    {
+        case tf::DT_FLOAT:
+            BlendTileImpl<Src, float>(tile, weights_x, weights_y, x, y, image);
+            break;
+
+        case tf::DT_HALF:
+            BlendTileImpl<Src, Eigen::half>(tile, weights_x, weights_y, x, y, image);
+            break;
+
+        default:
+            throw std::runtime_error("Unsupported image data type: " + tf::DataTypeString(image.dtype()));
+    }
+}
+
+} // namespace
+
+
+namespace ML {
+
+TileAxis::TileAxis(size_t image_size, size_t tile_size, size_t overlap, size_t scale)
+    : m_tile_size(std::min(image_size, tile_size))
+{
+    if (overlap >= tile_size)
+    {
+        throw std::runtime_error("Tile overlap must be less than tile size");
+    }
+
+    size_t tile_count = 1;
+    if (image_size > tile_size)
+    {
+        size_t step = tile_size - overlap;
+        tile_count += (image_size - tile_size + step - 1) / step;
+    }
+
+    // Spread the tiles evenly, so the overlaps are as equal as possible
+    for (size_t i = 0; i < tile_count; i++)
+    {
+        m_origins.push_back(tile_count > 1 ? i * (image_size - m_tile_size) / (tile_count - 1) : 0);
+    }
+
+    // Linear ramps over the overlapping areas, no ramps at the image borders
+    size_t output_tile_size = m_tile_size * scale;
+    float ramp = static_cast<float>(overlap * scale);
+
+    std::vector<float> weight_sums(image_size * scale);
+
+    for (size_t i = 0; i < tile_count; i++)
+    {
+        std::vector<float> weights(output_tile_size, 1.f);
+
+        for (size_t pos = 0; pos < output_tile_size && ramp > 0; pos++)
+        {
+            if (i > 0)
+            {
+                weights[pos] = std::min(weights[pos], (pos + .5f) / ramp);
+            }
+            if (i + 1 < tile_count)
+            {
+                weights[pos] = std::min(weights[pos], (output_tile_size - pos - .5f) / ramp);
+            }
+        }
+
+        for (size_t pos = 0; pos < output_tile_size; pos++)
+        {
+            weight_sums[m_origins[i] * scale + pos] += weights[pos];
+        }
+
+        m_weights.push_back(std::move(weights));
+    }
+
+    for (size_t i = 0; i < tile_count; i++)
+    {
+        for (size_t pos = 0; pos < output_tile_size; pos++)
+        {
+            m_weights[i][pos] /= weight_sums[m_origins[i] * scale + pos];
+        }
+    }
+}
+
+void CopyTile(const tf::Tensor& image, size_t x, size_t y, tf::Tensor& tile)
+{
+    size_t tile_height = tile.dim_size(1);
+    size_t tile_row_elements = tile.dim_size(2) * tile.dim_size(3);
+    size_t tile_row_size = tile_row_elements * tf::DataTypeSize(tile.dtype());
+    size_t image_row_size = image.dim_size(2) * image.dim_size(3) * tf::DataTypeSize(image.dtype());
+    size_t pixel_size = image.dim_size(3) * tf::DataTypeSize(image.dtype());
+
+    auto src = image.tensor_data().data() + y * image_row_size + x * pixel_size;
+    auto dst = const_cast<char*>(tile.tensor_data().data());
+
+    for (size_t row = 0; row < tile_height; row++)
+    {
+        ConvertData(image.dtype(), src + row * image_row_size,
+                    tile.dtype(), dst + row * tile_row_size, tile_row_elements);
+    }
+}
+
+void BlendTile(const tf::Tensor& tile,
+               const std::vector<float>& weights_x,
+               const std::vector<float>& weights_y,
+               size_t x,
+               size_t y,
+               tf::Tensor& image)
+{
+    switch (tile.dtype())
+    {
+        case tf::DT_FLOAT:
+            BlendTileToImage<float>(tile, weights_x, weights_y, x, y, image);
+            break;
+
+        case tf::DT_HALF:
+            BlendTileToImage<Eigen::half>(tile, weights_x, weights_y, x, y, image);
+            break;
+
+        default:
+            throw std::runtime_error("Unsupported tile data type: " + tf::DataTypeString(tile.dtype()));
+    }
+}
+
+} // namespace ML
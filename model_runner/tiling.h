@@ -0,0 +1,45 @@
+#pragma once
+
+#include "tensorflow/core/framework/tensor.h"
+
+#include <vector>
+
+
+namespace ML {
+
+/**
+ * Tile placement along a single image axis. Tiles of the same size cover
+ * the whole axis, neighbouring tiles share at least `overlap` pixels.
+ */
+class TileAxis
+{
+public:
+    TileAxis(size_t image_size, size_t tile_size, size_t overlap, size_t scale);
+
+    size_t GetTileCount() const { return m_origins.size(); }
+    size_t GetTileSize() const { return m_tile_size; }
+    size_t GetTileOrigin(size_t index) const { return m_origins[index]; }
+
+    // Blending weights of a tile in the output space (the input space
+    // multiplied by the scale), weights of all tiles sum up to 1
+    const std::vector<float>& GetTileWeights(size_t index) const { return m_weights[index]; }
+
+private:
+    size_t m_tile_size;
+    std::vector<size_t> m_origins;
+    std::vector<std::vector<float>> m_weights;
+};
+
+// Copies a tile at (x, y) from a (1, height, width, channels) image tensor,
+// converting the data to the tile data type
+void CopyTile(const tensorflow::Tensor& image, size_t x, size_t y, tensorflow::Tensor& tile);
+
+// Adds a weighted tile to an image tensor at (x, y), the data types may differ
+void BlendTile(const tensorflow::Tensor& tile,
+               const std::vector<float>& weights_x,
+               const std::vector<float>& weights_y,
+               size_t x,
+               size_t y,
+               tensorflow::Tensor& image);
+
+} // namespace ML
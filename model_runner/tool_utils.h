@@ -0,0 +1,36 @@
+#pragma once
+
+#include "model_runner.h"
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+// Helpers shared by the tools using the model runner API
+
+inline void CheckContextStatus(ml_context context, bool status)
+{
+    if (!status)
+    {
+        std::vector<char> buffer(1024);
+        throw std::runtime_error(mlGetContextError(context, buffer.data(), buffer.size()));
+    }
+}
+
+inline void CheckModelStatus(ml_model model, bool status)
+{
+    if (!status)
+    {
+        std::vector<char> buffer(1024);
+        throw std::runtime_error(mlGetModelError(model, buffer.data(), buffer.size()));
+    }
+}
+
+template<class T>
+auto MakeReleaser(T handle, void(* release_func)(T))
+{
+    auto release = [handle, release_func](void*) { release_func(handle); };
+    std::unique_ptr<void, decltype(release)> releaser(&handle, release);
+    return releaser;
+}
@@ -0,0 +1,257 @@
+#include "trace.h"
+
+#include "json.h"
+
+#include "tensorflow/core/framework/step_stats.pb.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+
+namespace tf = tensorflow;
+
+namespace {
+
+constexpr size_t kDefaultTopOpCount = 20;
+
+std::atomic<size_t> g_tracer_count{0};
+
+int GetProcessId()
+{
+#ifdef _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+}
+
+size_t GetEnvironmentSize(char const* name)
+{
+    char const* value = std::getenv(name);
+    return value != nullptr ? std::strtoul(value, nullptr, 10) : 0;
+}
+
+// Timeline labels look like "name = Conv2D(input, filter)"
+std::string GetOpType(const tf::NodeExecStats& node)
+{
+    auto& label = node.timeline_label();
+    size_t begin = label.find(" = ");
+    if (begin == std::string::npos)
+    {
+        return node.node_name();
+    }
+
+    begin += 3;
+    size_t end = label.find('(', begin);
+    return label.substr(begin, end != std::string::npos ? end - begin : std::string::npos);
+}
+
+struct OpTime
+{
+    std::string name;
+    std::string type;
+    tf::int64 micros = 0;
+    size_t count = 0;
+};
+
+void WriteTimeline(std::ostream& stream, const tf::StepStats& step_stats)
+{
+    // Timestamps start from the first op of the run
+    tf::int64 start = std::numeric_limits<tf::int64>::max();
+    for (auto& device : step_stats.dev_stats())
+    {
+        for (auto& node : device.node_stats())
+        {
+            start = std::min(start, node.all_start_micros());
+        }
+    }
+
+    stream << "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [";
+
+    char const* separator = "\n";
+    for (int pid = 0; pid < step_stats.dev_stats().size(); pid++)
+    {
+        auto& device = step_stats.dev_stats()[pid];
+
+        stream << separator
+               << "    {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid
+               << ", \"args\": {\"name\": " << JsonString(device.device()) << "}}";
+        separator = ",\n";
+
+        for (auto& node : device.node_stats())
+        {
+            stream << separator
+                   << "    {\"name\": " << JsonString(GetOpType(node))
+                   << ", \"cat\": \"Op\", \"ph\": \"X\""
+                   << ", \"ts\": " << node.all_start_micros() - start
+                   << ", \"dur\": " << node.all_end_rel_micros()
+                   << ", \"pid\": " << pid
+                   << ", \"tid\": " << node.thread_id()
+                   << ", \"args\": {\"name\": " << JsonString(node.node_name())
+                   << ", \"label\": " << JsonString(node.timeline_label()) << "}}";
+        }
+    }
+
+    stream << "\n  ]\n}\n";
+}
+
+void WriteOpTable(std::ostream& stream, const std::vector<OpTime>& ops, tf::int64 total_micros,
+                  size_t top_op_count, bool is_by_type)
+{
+    stream << std::setw(10) << "ms" << std::setw(8) << "%" << std::setw(8) << "count"
+           << "  " << (is_by_type ? "type" : "type / node") << "\n";
+
+    for (size_t i = 0; i < std::min(ops.size(), top_op_count); i++)
+    {
+        auto& op = ops[i];
+        stream << std::setw(10) << op.micros / 1000.
+               << std::setw(8) << (total_micros != 0 ? 100. * op.micros / total_micros : 0.)
+               << std::setw(8) << op.count << "  " << op.type;
+
+        if (!is_by_type)
+        {
+            stream << " / " << op.name;
+        }
+        stream << "\n";
+    }
+}
+
+void WriteSummary(std::ostream& stream, size_t trace_index, const tf::StepStats& step_stats,
+                  size_t top_op_count)
+{
+    std::map<std::string, OpTime> node_times;
+    std::map<std::string, OpTime> type_times;
+    tf::int64 start = std::numeric_limits<tf::int64>::max();
+    tf::int64 end = 0;
+    tf::int64 total_micros = 0;
+
+    for (auto& device : step_stats.dev_stats())
+    {
+        for (auto& node : device.node_stats())
+        {
+            auto type = GetOpType(node);
+
+            for (auto op : { &node_times[node.node_name()], &type_times[type] })
+            {
+                op->name = node.node_name();
+                op->type = type;
+                op->micros += node.all_end_rel_micros();
+                op->count++;
+            }
+
+            start = std::min(start, node.all_start_micros());
+            end = std::max(end, node.all_start_micros() + node.all_end_rel_micros());
+            total_micros += node.all_end_rel_micros();
+        }
+    }
+
+    auto sort_ops = [](const std::map<std::string, OpTime>& times)
+    {
+        std::vector<OpTime> ops;
+        for (auto& name_time : times)
+        {
+            ops.push_back(name_time.second);
+        }
+
+        std::sort(ops.begin(), ops.end(), [](const OpTime& a, const OpTime& b)
+        {
+            return a.micros > b.micros;
+        });
+        return ops;
+    };
+
+    stream << std::fixed << std::setprecision(3)
+           << "Trace " << trace_index << ": " << node_times.size() << " ops, "
+           << (end > start ? (end - start) / 1000. : 0.) << " ms wall time, "
+           << total_micros / 1000. << " ms op time\n\n"
+           << "Slowest ops:\n";
+
+    WriteOpTable(stream, sort_ops(node_times), total_micros, top_op_count, false);
+
+    stream << "\nSlowest op types:\n";
+
+    WriteOpTable(stream, sort_ops(type_times), total_micros, top_op_count, true);
+}
+
+} // namespace
+
+
+namespace ML {
+
+Tracer::Tracer(const ml_model_params& params)
+    : m_interval(params.trace_interval)
+    , m_max_count(params.trace_count)
+    , m_top_op_count(params.trace_top_ops != 0 ? params.trace_top_ops : kDefaultTopOpCount)
+    , m_id(g_tracer_count++)
+{
+    // Lets models be profiled in production without rebuilding the application
+    if (params.trace_path != nullptr)
+    {
+        m_path = params.trace_path;
+    }
+    else if (std::getenv("ML_TRACE_PATH") != nullptr)
+    {
+        m_path = std::getenv("ML_TRACE_PATH");
+    }
+
+    if (m_interval == 0)
+    {
+        m_interval = std::max<size_t>(GetEnvironmentSize("ML_TRACE_INTERVAL"), 1);
+    }
+
+    if (m_max_count == 0)
+    {
+        m_max_count = std::max<size_t>(GetEnvironmentSize("ML_TRACE_COUNT"), 1);
+    }
+}
+
+bool Tracer::StartTrace(size_t& trace_index)
+{
+    if (!IsEnabled())
+    {
+        return false;
+    }
+
+    size_t run_index = m_run_count.fetch_add(1, std::memory_order_relaxed);
+    if (run_index % m_interval != 0 || run_index / m_interval >= m_max_count)
+    {
+        return false;
+    }
+
+    trace_index = run_index / m_interval;
+    return true;
+}
+
+bool Tracer::WriteTrace(size_t trace_index, const tf::RunMetadata& metadata, std::string& error) const
+{
+    // Models of a process and processes sharing the prefix write separate files
+    auto path = m_path + "." + std::to_string(GetProcessId()) + "." + std::to_string(m_id) +
+                "." + std::to_string(trace_index);
+
+    std::ofstream timeline(path + ".json");
+    WriteTimeline(timeline, metadata.step_stats());
+
+    std::ofstream summary(path + ".txt");
+    WriteSummary(summary, trace_index, metadata.step_stats(), m_top_op_count);
+
+    if (timeline.fail() || summary.fail())
+    {
+        error = "Error writing trace " + path;
+        return false;
+    }
+    return true;
+}
+
+} // namespace ML
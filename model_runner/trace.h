@@ -0,0 +1,42 @@
+#pragma once
+
+#include "model_runner.h"
+
+#include "tensorflow/core/protobuf/config.pb.h"
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+
+namespace ML {
+
+/**
+ * Selects session runs to trace and writes their step statistics as Chrome
+ * trace timelines with summaries of the slowest ops.
+ */
+class Tracer
+{
+public:
+    // Parameters not set by the model fall back to environment variables
+    explicit Tracer(const ml_model_params& params);
+
+    bool IsEnabled() const { return !m_path.empty(); }
+
+    // Returns true if the next session run is to be traced,
+    // trace_index receives the trace number used in file names
+    bool StartTrace(size_t& trace_index);
+
+    // Writes the timeline and the summary of a traced run
+    bool WriteTrace(size_t trace_index, const tensorflow::RunMetadata& metadata, std::string& error) const;
+
+private:
+    std::string m_path;
+    size_t m_interval;
+    size_t m_max_count;
+    size_t m_top_op_count;
+    size_t m_id; // Unique within the process
+    std::atomic<size_t> m_run_count{0};
+};
+
+} // namespace ML
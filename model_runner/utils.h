@@ -3,8 +3,12 @@
 #include "model_runner.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
+#include <sstream>
 #include <string>
+#include <unordered_map>
 
 
 namespace ML {
@@ -19,12 +23,78 @@ bool ForEachDim(const Visitor& visitor)
 
 inline char* FillBuffer(char* buffer, size_t buffer_size, std::string message)
 {
-    if (buffer != nullptr)
+    if (buffer != nullptr && buffer_size != 0)
     {
-        message.erase(std::min(message.size(), buffer_size) - 1);
+        message.erase(std::min(message.size(), buffer_size - 1));
         std::memcpy(buffer, message.c_str(), message.size() + 1);
     }
     return buffer;
 };
 
+/**
+ * Error message storage with a separate message for each thread,
+ * so concurrent operations do not overwrite each other's errors.
+ * Messages are kept by the reporting threads and freed when cleared
+ * or when the threads exit. Mimics the std::ostringstream interface.
+ */
+class ThreadErrorCache
+{
+public:
+    ThreadErrorCache()
+        : m_id(GetNextId())
+    {
+    }
+
+    ThreadErrorCache(const ThreadErrorCache&) = delete;
+    ThreadErrorCache& operator=(const ThreadErrorCache&) = delete;
+
+    ~ThreadErrorCache()
+    {
+        GetStreams().erase(m_id);
+    }
+
+    template<class T>
+    std::ostream& operator<<(const T& value)
+    {
+        return GetStreams()[m_id] << value;
+    }
+
+    std::string str() const
+    {
+        auto& streams = GetStreams();
+        auto stream = streams.find(m_id);
+        return stream != streams.end() ? stream->second.str() : std::string();
+    }
+
+    void str(const std::string& message)
+    {
+        if (message.empty())
+        {
+            GetStreams().erase(m_id);
+            return;
+        }
+
+        GetStreams()[m_id].str(message);
+    }
+
+private:
+    typedef std::unordered_map<uint64_t, std::ostringstream> StreamMap;
+
+    // Caches are told apart by ids rather than addresses,
+    // so a new cache never sees messages left for a destroyed one
+    static uint64_t GetNextId()
+    {
+        static std::atomic<uint64_t> next_id{0};
+        return next_id++;
+    }
+
+    static StreamMap& GetStreams()
+    {
+        thread_local StreamMap streams;
+        return streams;
+    }
+
+    uint64_t m_id;
+};
+
 } // namespace ML